@@ -0,0 +1,177 @@
+#ifndef ADMISSION_HPP
+#define ADMISSION_HPP
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <sched.h>
+#include "shm_ring.hpp"
+
+// Lock-free admission to one intersection, for server threads that share intersections instead of each owning a
+// shard of them. The sharded server never needs it, every intersection there has a single owner, but it is what
+// replaces the count in the allocation table once more than one thread can grant the same intersection. Only
+// testing.cpp and the contention benchmark use it today.
+//
+// The state is a single 64 bit word, units in use in the low half and trains queued in the high half, so every
+// acquire or release is one CAS and acquires on different intersections touch different cache lines. A train
+// can't take a free unit while others are queued, and a release with trains queued hands its unit straight to the
+// one at the front of a lock-free FIFO instead of freeing it, the same rules as the wait queue in the graph.
+
+#define ADMISSION_USED_MASK 0xFFFFFFFFull
+#define ADMISSION_WAITER ((uint64_t)1 << 32)
+
+// Bounded FIFO of waiting train ids that any number of threads may push to and pop from (Vyukov's bounded MPMC
+// queue). Each slot carries a sequence number saying whether it is ready to be written or read on the current lap.
+class WaiterQueue {
+    private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        int train_id;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t mask;
+    alignas(RING_CACHE_LINE) std::atomic<size_t> tail; // Next slot to push to
+    alignas(RING_CACHE_LINE) std::atomic<size_t> head; // Next slot to pop from
+
+    public:
+    // Rounded up to a power of two, and never below two. With a single slot, the sequence number a push leaves in
+    // the slot is the same one that marks it free for the next push, so a full slot would look empty.
+    explicit WaiterQueue(size_t capacity) : tail(0), head(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots.reset(new Slot[size]);
+        mask = size - 1;
+        for (size_t i = 0; i < size; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(int trainId) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[position & mask];
+            intptr_t lap = (intptr_t)slot->sequence.load(std::memory_order_acquire) - (intptr_t)position;
+            if (lap == 0 && tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            } else if (lap < 0) {
+                return false; // Full
+            } else if (lap > 0) {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+        slot->train_id = trainId;
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(int& trainId) {
+        size_t position = head.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[position & mask];
+            intptr_t lap = (intptr_t)slot->sequence.load(std::memory_order_acquire) - (intptr_t)(position + 1);
+            if (lap == 0 && head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            } else if (lap < 0) {
+                return false; // Empty
+            } else if (lap > 0) {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+        trainId = slot->train_id;
+        slot->sequence.store(position + mask + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+class IntersectionAdmission {
+    private:
+    alignas(RING_CACHE_LINE) std::atomic<uint64_t> word; // Units in use | trains queued << 32
+    uint32_t capacity;
+    WaiterQueue waiters;
+
+    static uint32_t used(uint64_t value) { return value & ADMISSION_USED_MASK; }
+    static uint32_t queued(uint64_t value) { return value >> 32; }
+
+    // Takes back the count of a train whose id didn't fit in the FIFO. Every queued count is either an id in the
+    // FIFO or a train about to push one, and a release pops one id per count it takes. With the count already at 0
+    // a release has taken this train's count and waits for an id, so it keeps pushing until the pop it's waiting
+    // on makes room. Returns false in that case, the train is queued after all.
+    bool uncount(int trainId) {
+        uint64_t current = word.load(std::memory_order_acquire);
+        while (queued(current) != 0) {
+            if (word.compare_exchange_weak(current, current - ADMISSION_WAITER, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return true;
+            }
+        }
+        while (!waiters.push(trainId)) {
+            sched_yield();
+        }
+        return false;
+    }
+
+    public:
+    // maxWaiters sizes the FIFO, e.g. the number of trains whose routes visit the intersection. Past it a train
+    // waiting to queue spins in acquireOrWait until a release makes room.
+    IntersectionAdmission(uint32_t capacity, size_t maxWaiters) : word(0), capacity(capacity), waiters(maxWaiters) {}
+
+    // Takes a unit if one is free and nobody is queued
+    bool tryAcquire() {
+        uint64_t current = word.load(std::memory_order_acquire);
+        do {
+            if (queued(current) != 0 || used(current) >= capacity) {
+                return false;
+            }
+        } while (!word.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire));
+        return true;
+    }
+
+    // Takes a unit like tryAcquire, or else queues the train. Returns false when it was queued, a later release
+    // hands it a unit and returns its id.
+    bool acquireOrWait(int trainId) {
+        while (true) {
+            uint64_t current = word.load(std::memory_order_acquire);
+            uint64_t next;
+            do {
+                bool admit = queued(current) == 0 && used(current) < capacity;
+                next = admit ? current + 1 : current + ADMISSION_WAITER;
+            } while (!word.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_acquire));
+            if (next == current + 1) {
+                return true;
+            }
+            if (waiters.push(trainId) || !uncount(trainId)) {
+                return false;
+            }
+            sched_yield(); // More trains wait than maxWaiters, try again once a release has made room
+        }
+    }
+
+    // Gives a unit back. Returns -1 if it was freed, or the id of the queued train it was handed to. The unit
+    // passes on as soon as the CAS lands, so the waiter may still be between counting itself and pushing its id,
+    // in which case this waits the few instructions it takes.
+    int release() {
+        uint64_t current = word.load(std::memory_order_acquire);
+        uint64_t next;
+        do {
+            next = queued(current) != 0 ? current - ADMISSION_WAITER : current - 1;
+        } while (!word.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_acquire));
+        if (queued(current) == 0) {
+            return -1;
+        }
+        int trainId;
+        while (!waiters.pop(trainId)) {
+            sched_yield();
+        }
+        return trainId;
+    }
+
+    uint32_t inUse() const { return used(word.load(std::memory_order_acquire)); }
+    uint32_t waiting() const { return queued(word.load(std::memory_order_acquire)); }
+};
+
+#endif
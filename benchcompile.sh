@@ -0,0 +1 @@
+g++ -O2 -o bench benchmarking.cpp deadlock_detection.cpp ipc.cpp parsing.cpp topology.cpp -std=c++17
@@ -0,0 +1,668 @@
+/*
+Group B
+Author: Gavin Zlatar
+Email: gavin.zlatar@okstate.edu
+Date: 10/17/2026
+
+Description: Performance benchmarks for the server's hot paths, its IPC, intersection admission, config parsing and the
+memory each forked train takes. Each benchmark replays the same synthetic workload through the old and new
+implementation and prints the cost for both.
+*/
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/wait.h>
+
+#include "deadlock_detection.hpp"
+#include "ipc.hpp"
+#include "admission.hpp"
+#include "parsing.hpp"
+#include "topology.hpp"
+
+// Microseconds elapsed since start
+static double elapsedMicros(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Benchmark 1: deadlock detection. Replays a stream of wait-for graph updates, as the server sees them on
+// ACQUIRE/RELEASE, and compares a full isCyclicUtil DFS after every message against the incremental
+// WaitForGraph search that only runs when a train is queued. Trains only wait on lower numbered trains so
+// no cycle is ever found and both versions do their full amount of work.
+void deadlock_detection_benchmark(int numTrains, int numMessages)
+{
+    std::mt19937 rng(numTrains);
+    std::uniform_int_distribution<int> pickTrain(1, numTrains - 1);
+
+    std::vector<std::string> names;
+    for (int i = 0; i < numTrains; ++i)
+    {
+        names.push_back("Train" + std::to_string(i + 1));
+    }
+
+    // Generate the message stream up front so both versions see the same updates
+    struct Update
+    {
+        int train;
+        std::vector<int> waitingOn; // empty means the train was granted or released
+    };
+    std::vector<Update> updates;
+    for (int m = 0; m < numMessages; ++m)
+    {
+        Update update;
+        update.train = pickTrain(rng);
+        if (rng() % 2 == 0)
+        {
+            int holders = 1 + rng() % 2;
+            for (int h = 0; h < holders; ++h)
+            {
+                update.waitingOn.push_back(rng() % update.train);
+            }
+        }
+        updates.push_back(update);
+    }
+
+    // Old: name keyed map and a full DFS after every message
+    std::unordered_map<std::string, std::vector<std::string>> waitingGraph;
+    std::vector<std::string> cycle;
+    int fullCycles = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const Update &update : updates)
+    {
+        const std::string &train = names[update.train];
+        if (update.waitingOn.empty())
+        {
+            waitingGraph.erase(train);
+        }
+        else
+        {
+            std::vector<std::string> &edges = waitingGraph[train];
+            edges.clear();
+            for (int holder : update.waitingOn)
+            {
+                edges.push_back(names[holder]);
+            }
+        }
+        if (detectDeadlock(waitingGraph, cycle))
+        {
+            fullCycles++;
+        }
+    }
+    double fullMicros = elapsedMicros(start);
+
+    // New: dense ids and a search through the queued train only
+    WaitForGraph graph;
+    graph.resize(numTrains);
+    std::vector<int> cycleNodes;
+    int incrementalCycles = 0;
+    start = std::chrono::steady_clock::now();
+    for (const Update &update : updates)
+    {
+        if (update.waitingOn.empty())
+        {
+            graph.clearEdges(update.train);
+        }
+        else
+        {
+            graph.setEdges(update.train, update.waitingOn);
+            if (graph.findCycleThrough(update.train, cycleNodes))
+            {
+                incrementalCycles++;
+            }
+        }
+    }
+    double incrementalMicros = elapsedMicros(start);
+
+    std::cout << "benchmarking.cpp: " << numTrains << " trains, " << numMessages << " messages | "
+              << "full DFS: " << fullMicros / numMessages << " us/msg | "
+              << "incremental: " << incrementalMicros / numMessages << " us/msg | "
+              << "speedup: " << fullMicros / incrementalMicros << "x"
+              << " | cycles " << fullCycles << "/" << incrementalCycles << std::endl;
+}
+
+// Benchmark 2: IPC transport. A forked child plays one train. Latency is a GRANT/RELEASE ping-pong, one message
+// each way per round trip. Throughput is the child streaming RELEASEs into the request queue as fast as the server
+// side can take them, as the server sees it when every train is sending at once.
+void ipc_transport_benchmark(IpcTransport transport, int numMessages)
+{
+    if (ipc_setup(1, transport) == -1)
+    {
+        std::cerr << "benchmarking.cpp: IPC setup failed" << std::endl;
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        msg_request msg;
+        for (int i = 0; i < numMessages; ++i)
+        {
+            receive_msg(responseQueueId, msg, TRAIN_REPLY_TYPE(0));
+            msg.mtype = MSG_TYPE_DEFAULT;
+            msg.opcode = OP_RELEASE;
+            send_msg(requestQueueId, msg);
+        }
+        for (int i = 0; i < numMessages; ++i)
+        {
+            msg.seq = i;
+            send_msg(requestQueueId, msg);
+        }
+        exit(0);
+    }
+
+    msg_request msg;
+    msg.mtype = TRAIN_REPLY_TYPE(0);
+    msg.opcode = OP_GRANT;
+    msg.train_id = 0;
+    msg.intersection_id = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numMessages; ++i)
+    {
+        msg.seq = i;
+        send_msg(responseQueueId, msg);
+        receive_msg(requestQueueId, msg);
+        msg.mtype = TRAIN_REPLY_TYPE(0);
+    }
+    double roundTripMicros = elapsedMicros(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numMessages; ++i)
+    {
+        receive_msg(requestQueueId, msg);
+    }
+    double streamMicros = elapsedMicros(start);
+    waitpid(pid, nullptr, 0);
+
+    std::cout << "benchmarking.cpp: " << transport_name(transport) << ", " << numMessages << " messages | "
+              << "round trip: " << roundTripMicros / numMessages << " us | "
+              << "throughput: " << numMessages / streamMicros << " M msg/s" << std::endl;
+}
+
+// Mutex and count per intersection, how Intersection::acquire worked before admission moved into the allocation table
+struct LockedAdmission
+{
+    std::mutex lock;
+    uint32_t used = 0;
+    uint32_t capacity;
+
+    explicit LockedAdmission(uint32_t capacity) : capacity(capacity) {}
+
+    bool tryAcquire()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (used >= capacity)
+        {
+            return false;
+        }
+        used++;
+        return true;
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        used--;
+    }
+};
+
+// Runs numThreads threads that each try to cross opsPerThread intersections picked at random from the first ones
+// given, releasing straight after every acquire that succeeds. Returns millions of attempts per second.
+template <typename Admission>
+static double admission_sweep(std::vector<std::unique_ptr<Admission>> &intersections, int numThreads, int opsPerThread)
+{
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < numThreads; ++t)
+    {
+        threads.emplace_back([&intersections, opsPerThread, t]()
+        {
+            std::mt19937 rng(t);
+            std::uniform_int_distribution<size_t> pick(0, intersections.size() - 1);
+            for (int i = 0; i < opsPerThread; ++i)
+            {
+                Admission &admission = *intersections[pick(rng)];
+                if (admission.tryAcquire())
+                {
+                    admission.release();
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    return (double)numThreads * opsPerThread / elapsedMicros(start);
+}
+
+// Benchmark 3: intersection admission under contention. Sweeps the number of threads granting at once against the
+// number of intersections they share, from every thread on one intersection to almost no overlap, and compares a
+// mutex per intersection with the lock-free admission word from admission.hpp.
+void admission_benchmark(int numIntersections, int numThreads, int opsPerThread)
+{
+    std::vector<std::unique_ptr<LockedAdmission>> locked;
+    std::vector<std::unique_ptr<IntersectionAdmission>> lockFree;
+    for (int i = 0; i < numIntersections; ++i)
+    {
+        locked.emplace_back(new LockedAdmission(2));
+        lockFree.emplace_back(new IntersectionAdmission(2, numThreads));
+    }
+
+    double lockedRate = admission_sweep(locked, numThreads, opsPerThread);
+    double lockFreeRate = admission_sweep(lockFree, numThreads, opsPerThread);
+    std::cout << "benchmarking.cpp: " << numThreads << " threads, " << numIntersections << " intersections | "
+              << "mutex: " << lockedRate << " M ops/s | "
+              << "lock-free: " << lockFreeRate << " M ops/s" << std::endl;
+}
+
+// The parser before it was memory mapped: getline into a stringstream per line, a trim that rebuilds every token a
+// character at a time, and a line of debug output per intersection and train, sent to /dev/null here
+static std::string legacyTrim(const std::string &str)
+{
+    std::string result;
+    for (char c : str)
+    {
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+        {
+            result += c;
+        }
+    }
+    return result;
+}
+
+static std::unordered_map<std::string, Intersection *> legacyParseIntersections(const std::string &filename, std::ostream &chatter)
+{
+    std::unordered_map<std::string, Intersection *> intersections;
+    std::ifstream file(filename);
+    std::string line;
+    while (getline(file, line))
+    {
+        std::stringstream ss(line);
+        std::string name;
+        unsigned int capacity;
+        getline(ss, name, ':');
+        ss >> capacity;
+        std::string crossing;
+        if (ss.peek() == ':')
+        {
+            ss.get();
+            getline(ss, crossing);
+        }
+        name = legacyTrim(name);
+        crossing = legacyTrim(crossing);
+        unsigned int crossing_ms = crossing.empty() ? DEFAULT_CROSSING_MS : strtoul(crossing.c_str(), nullptr, 10);
+        chatter << "parsing.cpp: Name : " << name << " , Capacity: " << capacity << " , Crossing: " << crossing_ms << "ms" << std::endl;
+        int id = intersections.size();
+        intersections[name] = new Intersection(name, capacity, id, crossing_ms);
+    }
+    return intersections;
+}
+
+static std::unordered_map<std::string, Train *> legacyParseTrains(const std::string &filename, std::unordered_map<std::string, Intersection *> &intersections, std::ostream &chatter)
+{
+    std::ifstream file(filename);
+    std::string line;
+    std::unordered_map<std::string, Train *> trains;
+    while (getline(file, line))
+    {
+        std::stringstream ss(line);
+        std::string name;
+        getline(ss, name, ':');
+        name = legacyTrim(name);
+        std::string intersection;
+        std::vector<Intersection *> route;
+        std::vector<unsigned int> travel_ms;
+        while (getline(ss, intersection, ','))
+        {
+            intersection = legacyTrim(intersection);
+            unsigned int travel = 0;
+            size_t plus = intersection.find('+');
+            if (plus != std::string::npos)
+            {
+                travel = strtoul(intersection.substr(plus + 1).c_str(), nullptr, 10);
+                intersection = intersection.substr(0, plus);
+            }
+            if (intersections.find(intersection) != intersections.end())
+            {
+                route.push_back(intersections[intersection]);
+                travel_ms.push_back(travel);
+            }
+        }
+        chatter << "parsing.cpp: Train: " << name << " | Route: ";
+        for (auto *hop : route)
+        {
+            chatter << hop->name << " ";
+        }
+        chatter << std::endl;
+        int id = trains.size();
+        trains[name] = new Train(name, route, id, travel_ms);
+    }
+    return trains;
+}
+
+template <typename Map>
+static void deleteParsed(Map &parsed)
+{
+    for (auto &[name, object] : parsed)
+    {
+        delete object;
+    }
+}
+
+// Writes a generated network with numTrains trains, each on a route of routeLength hops with travel times
+static void writeNetwork(const std::string &intersectionsPath, const std::string &trainsPath, int numIntersections, int numTrains, int routeLength)
+{
+    std::mt19937 rng(numTrains);
+    std::ofstream intersectionsFile(intersectionsPath);
+    for (int i = 0; i < numIntersections; ++i)
+    {
+        intersectionsFile << "Intersection" << i << ":" << 1 + rng() % 3 << ":" << 500 + rng() % 1000 << "\n";
+    }
+    std::ofstream trainsFile(trainsPath);
+    for (int t = 0; t < numTrains; ++t)
+    {
+        trainsFile << "Train" << t << ":";
+        for (int hop = 0; hop < routeLength; ++hop)
+        {
+            trainsFile << (hop ? "," : "") << "Intersection" << rng() % numIntersections << "+" << rng() % 2000;
+        }
+        trainsFile << "\n";
+    }
+}
+
+// Benchmark 4: config parsing at startup. Times the old line by line parser against the memory mapped one on a
+// generated network.
+void parsing_benchmark(int numIntersections, int numTrains, int routeLength)
+{
+    const std::string intersectionsPath = "bench_intersections.txt";
+    const std::string trainsPath = "bench_trains.txt";
+    writeNetwork(intersectionsPath, trainsPath, numIntersections, numTrains, routeLength);
+
+    std::ofstream devNull("/dev/null");
+    auto start = std::chrono::steady_clock::now();
+    auto legacyIntersections = legacyParseIntersections(intersectionsPath, devNull);
+    auto legacyTrains = legacyParseTrains(trainsPath, legacyIntersections, devNull);
+    double legacyMicros = elapsedMicros(start);
+
+    NetworkArena arena;
+    start = std::chrono::steady_clock::now();
+    auto intersections = parseIntersections(intersectionsPath, arena);
+    auto trains = parseTrains(trainsPath, intersections, arena);
+    double mappedMicros = elapsedMicros(start);
+
+    std::cout << "benchmarking.cpp: " << numTrains << " trains, " << routeLength << " hops each | "
+              << "getline: " << legacyMicros / 1000 << " ms | "
+              << "mmap: " << mappedMicros / 1000 << " ms | "
+              << "speedup: " << legacyMicros / mappedMicros << "x"
+              << " | trains " << legacyTrains.size() << "/" << trains.size() << std::endl;
+
+    deleteParsed(legacyTrains);
+    deleteParsed(legacyIntersections);
+    remove(intersectionsPath.c_str());
+    remove(trainsPath.c_str());
+}
+
+// Private dirty memory of this process in kB, the pages it has stopped sharing with the process it was forked from
+static long privateDirtyKb()
+{
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string line;
+    long kb = -1;
+    while (std::getline(smaps, line))
+    {
+        if (sscanf(line.c_str(), "Private_Dirty: %ld kB", &kb) == 1)
+        {
+            break;
+        }
+    }
+    return kb;
+}
+
+// Forks a process for every sampled train, as train_forking does, and has it walk its route. Returns the average
+// memory each one stopped sharing while it did.
+template <typename Walk>
+static double forkedWalkKb(int numTrains, int samples, Walk walk)
+{
+    double totalKb = 0;
+    for (int sample = 0; sample < samples; ++sample)
+    {
+        int trainId = (long)sample * numTrains / samples;
+        int pipeFds[2];
+        if (pipe(pipeFds) == -1)
+        {
+            return -1;
+        }
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            privateDirtyKb(); // Settle the pages reading smaps dirties itself
+            long before = privateDirtyKb();
+            walk(trainId);
+            long grown = privateDirtyKb() - before;
+            (void)!write(pipeFds[1], &grown, sizeof(grown));
+            _exit(0);
+        }
+        long grown = 0;
+        (void)!read(pipeFds[0], &grown, sizeof(grown));
+        waitpid(pid, nullptr, 0);
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+        totalKb += grown;
+    }
+    return totalKb / samples;
+}
+
+// Benchmark 5: memory per forked train. Every train process starts with a copy on write image of the server.
+// Erasing its way through its own route vector on the heap, as trains used to, copies the pages under it. Walking
+// a cursor through the read-only shared topology copies nothing.
+void train_memory_benchmark(int numIntersections, int numTrains, int routeLength)
+{
+    writeNetwork("bench_intersections.txt", "bench_trains.txt", numIntersections, numTrains, routeLength);
+    NetworkArena arena;
+    auto intersections = parseIntersections("bench_intersections.txt", arena);
+    auto trains = parseTrains("bench_trains.txt", intersections, arena);
+    std::vector<Intersection *> intersectionsList = intersectionsById(intersections);
+    std::vector<Train *> trainsList = trainsById(trains);
+    Topology topology;
+    topology.share(intersectionsList, trainsList);
+
+    // Each train's route and travel times as vectors of their own, the way Train used to hold them
+    std::vector<std::vector<Intersection *>> routes(numTrains);
+    std::vector<std::vector<unsigned int>> travel(numTrains);
+    for (Train *train : trainsList)
+    {
+        for (size_t hop = 0; hop < train->route.size(); ++hop)
+        {
+            routes[train->id].push_back(intersectionsList[train->route[hop]]);
+            travel[train->id].push_back(train->travel_ms[hop]);
+        }
+    }
+
+    const int samples = 50;
+    double eraseKb = forkedWalkKb(numTrains, samples, [&](int trainId)
+    {
+        while (!routes[trainId].empty())
+        {
+            routes[trainId].erase(routes[trainId].begin());
+            travel[trainId].erase(travel[trainId].begin());
+        }
+    });
+    double cursorKb = forkedWalkKb(numTrains, samples, [&](int trainId)
+    {
+        const TopologyTrain &train = topology.train(trainId);
+        volatile uint32_t crossing = 0;
+        for (uint32_t hop = 0; hop < train.hopCount; ++hop)
+        {
+            crossing += topology.intersection(topology.route(train)[hop]).crossing_ms + topology.travel(train)[hop];
+        }
+    });
+
+    std::cout << "benchmarking.cpp: " << numTrains << " trains, " << routeLength << " hops each | "
+              << "route erase: " << eraseKb << " kB per train process | "
+              << "shared cursor: " << cursorKb << " kB per train process | "
+              << "all trains: " << eraseKb * numTrains / 1024 << " MB vs " << cursorKb * numTrains / 1024 << " MB" << std::endl;
+
+    remove("bench_intersections.txt");
+    remove("bench_trains.txt");
+}
+
+// Walks every train's route in id order the way the server's avoidance and admission checks do, summing the
+// crossing times so the loads can't be optimized away
+static unsigned long walkRoutes(const std::vector<Train *> &trains, const std::vector<Intersection *> &intersections)
+{
+    unsigned long total = 0;
+    for (const Train *train : trains)
+    {
+        for (uint32_t hop : train->route)
+        {
+            total += intersections[hop]->crossing_ms;
+        }
+    }
+    return total;
+}
+
+// Benchmark 6: building, walking and freeing the network. Each Train and its two route vectors used to be separate
+// heap allocations, scattered once the allocator has been churned, and freed one by one at teardown. The arena lays
+// them out back to back and frees them a block at a time.
+void network_arena_benchmark(int numIntersections, int numTrains, int routeLength)
+{
+    std::mt19937 rng(numTrains);
+    std::vector<Intersection *> intersections;
+    for (int i = 0; i < numIntersections; ++i)
+    {
+        intersections.push_back(new Intersection("Intersection" + std::to_string(i), 1 + rng() % 3, i, 500 + rng() % 1000));
+    }
+    std::vector<std::vector<Intersection *>> routes(numTrains);
+    std::vector<std::vector<uint32_t>> routeIds(numTrains);
+    std::vector<std::vector<unsigned int>> travel(numTrains);
+    for (int t = 0; t < numTrains; ++t)
+    {
+        for (int hop = 0; hop < routeLength; ++hop)
+        {
+            routes[t].push_back(intersections[rng() % numIntersections]);
+            routeIds[t].push_back(routes[t].back()->id);
+            travel[t].push_back(rng() % 2000);
+        }
+    }
+    // A long running server's heap is fragmented, leave holes of mixed sizes for the heap objects to land in
+    std::vector<char *> churn;
+    for (int i = 0; i < numTrains * 4; ++i)
+    {
+        churn.push_back(new char[16 + rng() % 256]);
+    }
+    for (size_t i = 0; i < churn.size(); i += 2)
+    {
+        delete[] churn[i];
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Train *> heapTrains;
+    for (int t = 0; t < numTrains; ++t)
+    {
+        heapTrains.push_back(new Train("Train" + std::to_string(t), routes[t], t, travel[t]));
+    }
+    double heapBuildMicros = elapsedMicros(start);
+    start = std::chrono::steady_clock::now();
+    unsigned long heapTotal = walkRoutes(heapTrains, intersections);
+    double heapWalkMicros = elapsedMicros(start);
+    start = std::chrono::steady_clock::now();
+    for (Train *train : heapTrains)
+    {
+        delete train;
+    }
+    double heapFreeMicros = elapsedMicros(start);
+
+    std::unique_ptr<NetworkArena> arena(new NetworkArena());
+    start = std::chrono::steady_clock::now();
+    std::vector<Train *> arenaTrains;
+    for (int t = 0; t < numTrains; ++t)
+    {
+        arenaTrains.push_back(arena->newTrain("Train" + std::to_string(t), routeIds[t], t, travel[t], 0, 0));
+    }
+    double arenaBuildMicros = elapsedMicros(start);
+    start = std::chrono::steady_clock::now();
+    unsigned long arenaTotal = walkRoutes(arenaTrains, intersections);
+    double arenaWalkMicros = elapsedMicros(start);
+    start = std::chrono::steady_clock::now();
+    arena.reset();
+    double arenaFreeMicros = elapsedMicros(start);
+
+    std::cout << "benchmarking.cpp: " << numTrains << " trains, " << routeLength << " hops each | "
+              << "heap build/walk/free: " << heapBuildMicros / 1000 << "/" << heapWalkMicros / 1000 << "/" << heapFreeMicros / 1000 << " ms | "
+              << "arena build/walk/free: " << arenaBuildMicros / 1000 << "/" << arenaWalkMicros / 1000 << "/" << arenaFreeMicros / 1000 << " ms"
+              << (heapTotal == arenaTotal ? "" : " | MISMATCH") << std::endl;
+
+    for (size_t i = 1; i < churn.size(); i += 2)
+    {
+        delete[] churn[i];
+    }
+    for (Intersection *intersection : intersections)
+    {
+        delete intersection;
+    }
+}
+
+int main()
+{
+    std::cout << "-------------------------------------\n";
+    std::cout << "Starting deadlock detection benchmark...\n";
+    std::cout << "-------------------------------------\n";
+
+    deadlock_detection_benchmark(10, 20000);
+    deadlock_detection_benchmark(100, 20000);
+    deadlock_detection_benchmark(1000, 5000);
+    deadlock_detection_benchmark(5000, 2000);
+
+    std::cout << "-------------------------------------\n";
+    std::cout << "Starting IPC transport benchmark...\n";
+    std::cout << "-------------------------------------\n";
+
+    ipc_transport_benchmark(TRANSPORT_MSGQ, 100000);
+    ipc_transport_benchmark(TRANSPORT_SHM, 100000);
+    clear_resources();
+
+    std::cout << "-------------------------------------\n";
+    std::cout << "Starting admission contention benchmark...\n";
+    std::cout << "-------------------------------------\n";
+
+    for (int numThreads : {1, 2, 4, 8})
+    {
+        for (int numIntersections : {1, 16, 1024})
+        {
+            admission_benchmark(numIntersections, numThreads, 200000);
+        }
+    }
+
+    std::cout << "-------------------------------------\n";
+    std::cout << "Starting config parsing benchmark...\n";
+    std::cout << "-------------------------------------\n";
+
+    parsing_benchmark(100, 1000, 10);
+    parsing_benchmark(1000, 100000, 20);
+
+    std::cout << "-------------------------------------\n";
+    std::cout << "Starting train memory benchmark...\n";
+    std::cout << "-------------------------------------\n";
+
+    train_memory_benchmark(1000, 100000, 20);
+
+    std::cout << "-------------------------------------\n";
+    std::cout << "Starting network arena benchmark...\n";
+    std::cout << "-------------------------------------\n";
+
+    network_arena_benchmark(1000, 10000, 20);
+    network_arena_benchmark(1000, 100000, 20);
+
+    return 0;
+}
@@ -1 +1,5 @@
-g++ -o server server.cpp ipc.cpp parsing.cpp train.cpp deadlock_recovery.cpp logging.cpp resource_allocation.cpp -std=c++17
+g++ -o server server.cpp simulation.cpp event_sim.cpp ipc.cpp parsing.cpp train.cpp train_pool.cpp deadlock_recovery.cpp logging.cpp resource_allocation.cpp dispatch.cpp shard_server.cpp deadlock_detection.cpp deadlock_avoidance.cpp metrics.cpp topology.cpp trace.cpp -std=c++17
+g++ -o logrender logrender.cpp logging.cpp -std=c++17
+g++ -o runner runner.cpp simulation.cpp event_sim.cpp ipc.cpp parsing.cpp train.cpp train_pool.cpp deadlock_recovery.cpp logging.cpp resource_allocation.cpp dispatch.cpp shard_server.cpp deadlock_detection.cpp deadlock_avoidance.cpp metrics.cpp topology.cpp trace.cpp -std=c++17
+g++ -o topocompile topocompile.cpp topology.cpp parsing.cpp -std=c++17
+g++ -o replay replay.cpp simulation.cpp event_sim.cpp ipc.cpp parsing.cpp train.cpp train_pool.cpp deadlock_recovery.cpp logging.cpp resource_allocation.cpp dispatch.cpp shard_server.cpp deadlock_detection.cpp deadlock_avoidance.cpp metrics.cpp topology.cpp trace.cpp -std=c++17
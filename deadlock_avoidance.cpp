@@ -0,0 +1,210 @@
+/*
+Group: B
+Author: Gavin Zlatar
+Email: gavin.zlatar@okstate.edu
+Date: 10/17/2026
+
+Description: Deadlock avoidance for DEADLOCK_MODE=avoid. Before the server grants an intersection it asks
+isSafeToGrant whether every train could still finish its route afterwards, treating the rest of each train's route
+as its maximum claim like the Banker's algorithm. Grants that would leave an unsafe state are deferred: the train
+stays queued and is granted by a later release once the grant is safe, so recovery never has to preempt anyone.
+*/
+
+#include "deadlock_avoidance.hpp"
+
+// DEADLOCK_MODE=avoid turns on the safety check, detection and recovery stay on either way
+bool avoidanceModeFromEnv() {
+    const char* mode = getenv("DEADLOCK_MODE");
+    return mode && strcmp(mode, "avoid") == 0;
+}
+
+// Starts over with every train at the start of its route holding nothing, which is always safe
+void DeadlockAvoidance::reset(const vector<Train*>& trains, const ResourceAllocationGraph& graph) {
+    this->trains = trains;
+    this->graph = &graph;
+    nextHop.assign(trains.size(), 0);
+    held.assign(trains.size(), vector<int>());
+    holders.clear();
+    holderIndex.assign(trains.size(), -1);
+    releases = 0;
+    unsafeSince.assign(trains.size(), 0);
+    unsafeAt.assign(trains.size(), -1);
+    visits.assign(graph.size(), vector<RouteVisit>());
+    for (Train* train : trains) {
+        for (size_t hop = 0; hop < train->route.size(); ++hop) {
+            visits[train->route[hop]].push_back({train->id, hop});
+        }
+    }
+
+    blocked.assign(trains.size(), 0);
+    checkedMark.assign(trains.size(), 0);
+    finishedMark.assign(trains.size(), 0);
+    freed.assign(graph.size(), 0);
+    freedMark.assign(graph.size(), 0);
+    epoch = 0;
+}
+
+size_t DeadlockAvoidance::size() const {
+    return trains.size();
+}
+
+// Where the train's remaining route starts once it is granted the intersection. An intersection that isn't ahead
+// on its route (e.g. a test asking for something off route) doesn't move it along.
+size_t DeadlockAvoidance::hopAfterGrant(int trainId, int intersectionId) const {
+    const HopSpan& route = trains[trainId]->route;
+    for (size_t hop = nextHop[trainId]; hop < route.size(); ++hop) {
+        if ((int)route[hop] == intersectionId) {
+            return hop + 1;
+        }
+    }
+    return nextHop[trainId];
+}
+
+bool DeadlockAvoidance::holds(int trainId, int intersectionId) const {
+    return find(held[trainId].begin(), held[trainId].end(), intersectionId) != held[trainId].end();
+}
+
+// Read from the resource graph's allocation table so it can't drift from what has really been granted
+int DeadlockAvoidance::freeUnits(int intersectionId) const {
+    return graph->freeUnits(intersectionId);
+}
+
+// Whether granting the intersection to the train leaves a state where every train can still finish.
+// Assumes the current state is safe, which holds as long as every grant goes through this check.
+bool DeadlockAvoidance::isSafeToGrant(int trainId, int intersectionId) {
+    size_t grantedHop = hopAfterGrant(trainId, intersectionId);
+    const HopSpan& route = trains[trainId]->route;
+
+    // Fast path: the train can finish straight away, then the old safe order works for everyone else
+    bool canFinish = true;
+    for (size_t hop = grantedHop; hop < route.size() && canFinish; ++hop) {
+        int need = route[hop];
+        if (need != intersectionId && !holds(trainId, need) && freeUnits(need) <= 0) {
+            canFinish = false;
+        }
+    }
+    if (canFinish) {
+        return true;
+    }
+    if (unsafeAt[trainId] == intersectionId && unsafeSince[trainId] == releases) {
+        return false; // Nothing has been released since it was found unsafe
+    }
+
+    // Full check with the grant applied: let every train whose remaining hops all have a free unit finish and
+    // hand back what it holds, until nobody else can
+    epoch++;
+    auto holdsAfter = [&](int train, int need) {
+        return (train == trainId && need == intersectionId) || holds(train, need);
+    };
+    auto startOf = [&](int train) {
+        return train == trainId ? grantedHop : nextHop[train];
+    };
+    auto work = [&](int need) {
+        return freeUnits(need) - (need == intersectionId ? 1 : 0) + (freedMark[need] == epoch ? freed[need] : 0);
+    };
+
+    worklist.clear();
+    size_t checked = 0;
+    auto addToCheck = [&](int train) {
+        checkedMark[train] = epoch;
+        checked++;
+        blocked[train] = 0;
+        const HopSpan& trainRoute = trains[train]->route;
+        for (size_t hop = startOf(train); hop < trainRoute.size(); ++hop) {
+            int need = trainRoute[hop];
+            if (!holdsAfter(train, need) && work(need) <= 0) {
+                blocked[train]++;
+            }
+        }
+        if (blocked[train] == 0) {
+            finishedMark[train] = epoch;
+            worklist.push_back(train);
+        }
+    };
+    for (int train : holders) {
+        addToCheck(train);
+    }
+    if (holderIndex[trainId] == -1) {
+        addToCheck(trainId);
+    }
+
+    size_t finished = 0;
+    while (!worklist.empty()) {
+        int train = worklist.back();
+        worklist.pop_back();
+        finished++;
+
+        size_t handedBack = held[train].size() + (train == trainId ? 1 : 0);
+        for (size_t i = 0; i < handedBack; ++i) {
+            int freedId = i < held[train].size() ? held[train][i] : intersectionId;
+            int before = work(freedId);
+            if (freedMark[freedId] != epoch) {
+                freedMark[freedId] = epoch;
+                freed[freedId] = 0;
+            }
+            freed[freedId]++;
+            if (before != 0) {
+                continue; // Already had a free unit, nobody was blocked on it
+            }
+            // First free unit, every train still needing this intersection has one less blocked hop
+            for (const RouteVisit& visit : visits[freedId]) {
+                int waiter = visit.train_id;
+                if (checkedMark[waiter] != epoch || finishedMark[waiter] == epoch || visit.hop < startOf(waiter) || holdsAfter(waiter, freedId)) {
+                    continue;
+                }
+                if (--blocked[waiter] == 0) {
+                    finishedMark[waiter] = epoch;
+                    worklist.push_back(waiter);
+                }
+            }
+        }
+    }
+
+    if (finished != checked) {
+        unsafeAt[trainId] = intersectionId;
+        unsafeSince[trainId] = releases;
+        return false;
+    }
+    return true;
+}
+
+void DeadlockAvoidance::onGrant(int trainId, int intersectionId) {
+    size_t grantedHop = hopAfterGrant(trainId, intersectionId);
+    if (grantedHop != nextHop[trainId] + 1) {
+        releases++; // Skipped hops drop out of its claim, which can make other grants safe
+    }
+    nextHop[trainId] = grantedHop;
+    held[trainId].push_back(intersectionId);
+    if (holderIndex[trainId] == -1) {
+        holderIndex[trainId] = holders.size();
+        holders.push_back(trainId);
+    }
+}
+
+void DeadlockAvoidance::onRelease(int trainId, int intersectionId) {
+    releases++;
+    auto found = find(held[trainId].begin(), held[trainId].end(), intersectionId);
+    if (found != held[trainId].end()) {
+        held[trainId].erase(found);
+    }
+    if (held[trainId].empty() && holderIndex[trainId] != -1) {
+        // Swap the last holder into its place
+        int last = holders.back();
+        holders[holderIndex[trainId]] = last;
+        holderIndex[last] = holderIndex[trainId];
+        holders.pop_back();
+        holderIndex[trainId] = -1;
+    }
+}
+
+// Like a release, but the train has to cross the intersection again so its claim goes back to include it
+void DeadlockAvoidance::onPreempt(int trainId, int intersectionId) {
+    onRelease(trainId, intersectionId);
+    const HopSpan& route = trains[trainId]->route;
+    for (size_t hop = 0; hop < nextHop[trainId]; ++hop) {
+        if ((int)route[hop] == intersectionId) {
+            nextHop[trainId] = hop;
+            break;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef DEADLOCK_AVOIDANCE_HPP
+#define DEADLOCK_AVOIDANCE_HPP
+
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include "parsing.hpp"
+#include "resource_allocation.hpp"
+
+using namespace std;
+
+// Banker's style safety check for DEADLOCK_MODE=avoid. Every intersection is a resource with capacity units, and a
+// train's maximum claim is every intersection still ahead of it on its route. A grant is only made if afterwards
+// there is still some order in which every train could get the rest of its route and finish.
+//
+// The server only ever moves from one safe state to another, so many checks are answered by the fast path: if the
+// requesting train could finish straight after the grant, it can go first in that order and the rest of the old
+// order still works. Otherwise the full check runs as a worklist over a per-intersection index of the trains whose
+// routes use it, which is linear in the remaining routes instead of trains x trains x intersections. Only trains
+// holding something take part: once they have all finished every intersection is empty, so a train holding
+// nothing can always finish last. A grant never makes an unsafe grant safe, so a train found unsafe is not checked
+// again until something is released.
+class DeadlockAvoidance {
+    private:
+    // One visit in some train's route, for the index from an intersection back to the trains that need it
+    struct RouteVisit {
+        int train_id;
+        size_t hop;
+    };
+
+    vector<Train*> trains; // Indexed by train id
+    const ResourceAllocationGraph* graph = nullptr; // Holds the allocation table, free units are read from it
+    vector<size_t> nextHop; // Index into each train's route of the first hop it hasn't been granted yet
+    vector<vector<int>> held; // Intersections each train holds, ids
+    vector<int> holders; // Trains holding at least one intersection
+    vector<int> holderIndex; // Position of each train in holders, -1 if it holds nothing
+    vector<vector<RouteVisit>> visits; // visits[intersection] = every place it appears in a route
+    unsigned long releases = 0; // Bumped by every release, and by a grant that skips hops
+    vector<unsigned long> unsafeSince; // Value of releases when the train's last unsafe check ran
+    vector<int> unsafeAt; // Intersection that check was for, -1 if none
+
+    // Scratch space for the full check, reused between checks. Entries are valid when their mark equals epoch.
+    vector<int> blocked; // Hops still ahead of a train that have no free unit
+    vector<int> freed; // Units handed back by trains that the check has let finish
+    vector<unsigned int> checkedMark; // Train takes part in this check
+    vector<unsigned int> finishedMark;
+    vector<unsigned int> freedMark;
+    vector<int> worklist;
+    unsigned int epoch = 0;
+
+    size_t hopAfterGrant(int trainId, int intersectionId) const;
+    bool holds(int trainId, int intersectionId) const;
+    int freeUnits(int intersectionId) const;
+
+    public:
+    void reset(const vector<Train*>& trains, const ResourceAllocationGraph& graph);
+    size_t size() const;
+
+    bool isSafeToGrant(int trainId, int intersectionId);
+    void onGrant(int trainId, int intersectionId);
+    void onRelease(int trainId, int intersectionId);
+    void onPreempt(int trainId, int intersectionId);
+};
+
+bool avoidanceModeFromEnv();
+
+#endif
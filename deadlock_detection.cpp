@@ -0,0 +1,164 @@
+/*
+Group: B
+Author: Gavin Zlatar
+Email: gavin.zlatar@okstate.edu
+Date: 10/17/2026
+
+Description: Deadlock detection over the wait-for graph between trains. The server keeps a WaitForGraph indexed by
+train id and, whenever a train is queued, searches only for a cycle that leads back to that train, since the
+edges it just added are the only ones that can close a new cycle. detectDeadlock and isCyclicUtil are the original
+full DFS over a name-keyed graph, kept for the tests and as the baseline in benchmarking.cpp.
+*/
+
+#include "deadlock_detection.hpp"
+
+// One node per train id
+void WaitForGraph::resize(size_t numTrains) {
+    edges.resize(numTrains);
+    mark.resize(numTrains, 0);
+    parent.resize(numTrains, -1);
+}
+
+size_t WaitForGraph::size() const {
+    return edges.size();
+}
+
+// Replaces everything the train is waiting on
+void WaitForGraph::setEdges(int from, const vector<int>& to) {
+    edges[from] = to;
+}
+
+// The train isn't waiting on anyone anymore (granted or released)
+void WaitForGraph::clearEdges(int from) {
+    edges[from].clear();
+}
+
+const vector<int>& WaitForGraph::waitingOn(int node) const {
+    return edges[node];
+}
+
+bool WaitForGraph::isWaiting(int node) const {
+    return !edges[node].empty();
+}
+
+// Looks for a path from the node's out-edges back to the node itself. Any new cycle created by changing the node's
+// out-edges has to pass through it, so this is all that needs searching after a train is queued.
+// On success the cycle is listed starting at the node, each train waiting on the next and the last waiting on the first.
+bool WaitForGraph::findCycleThrough(int node, vector<int>& cycle) {
+    // New epoch instead of clearing the visited marks, reset only if the counter wraps
+    if (++epoch == 0) {
+        fill(mark.begin(), mark.end(), 0);
+        epoch = 1;
+    }
+
+    stack.clear();
+    mark[node] = epoch;
+    stack.push_back(node);
+
+    while (!stack.empty()) {
+        int current = stack.back();
+        stack.pop_back();
+
+        for (int next : edges[current]) {
+            if (next == node) {
+                // Walk the parents back to the start to rebuild the cycle
+                cycle.clear();
+                for (int at = current; at != node; at = parent[at]) {
+                    cycle.push_back(at);
+                }
+                cycle.push_back(node);
+                reverse(cycle.begin(), cycle.end());
+                return true;
+            }
+            if (mark[next] != epoch) {
+                mark[next] = epoch;
+                parent[next] = current;
+                stack.push_back(next);
+            }
+        }
+    }
+
+    return false;
+}
+
+void WaitForGraph::clear() {
+    edges.clear();
+    mark.clear();
+    parent.clear();
+    stack.clear();
+    epoch = 0;
+}
+
+bool detectDeadlock(const unordered_map<string, vector<string>>& waitingGraph, vector<string>& cycle) {
+    
+    unordered_map<string, bool> visited, recursionStack;
+    unordered_map<string, string> parent;
+
+    // initializes nodes as unvisited outside the stack
+    for (const auto& [node, _] : waitingGraph) {
+        visited[node] = false;
+        recursionStack[node] = false;
+    }
+
+    // checks the graph for cycles
+    for (const auto& [node, _] : waitingGraph) {
+        if (!visited[node]) {
+            if (isCyclicUtil(node, visited, recursionStack, waitingGraph, cycle, parent)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool isCyclicUtil(const string& node, // Current train
+    unordered_map<string, bool>& visited, // Has the train been seen before?
+    unordered_map<string, bool>& recursionStack, // Call stack path
+    const unordered_map<string, vector<string>>& graph, // waitingGraph - trains and the trains it's waiting on.
+    vector<string>& cycle,
+    unordered_map<string, string>& parent) {
+    /* For context, the 'neighbors' are what we call the trains that the current train is waiting on.
+    So to detect a deadlock the neighbor needs to both already have been visited and in the current recursion path.*/
+
+    // Say the node that we're visiting is visited and add to recursion stack
+    visited[node] = true;
+    recursionStack[node] = true;
+
+    // A train that isn't waiting on anything has no entry, so it can't be part of a cycle
+    auto neighbors = graph.find(node);
+    if (neighbors == graph.end()) {
+        recursionStack[node] = false;
+        return false;
+    }
+
+    // checking neighbors of the current node
+    for (const string& neighbor : neighbors->second) {
+
+        // If the neighbor hasn't been visited, we run a recursive call on it
+        if (!visited[neighbor]) {
+            parent[neighbor] = node;
+            if(isCyclicUtil(neighbor, visited, recursionStack, graph, cycle, parent)){
+                // Log that a cycle was detected
+                std::cout << "cycle detected!";
+                return true;
+            }
+        } else if (recursionStack[neighbor]) {
+            // Reconstructt he cycle so it can be sent to the deadlock recovery
+            cycle.clear();
+            string current = node;
+            cycle.push_back(neighbor);
+            while(current != neighbor) {
+                cycle.push_back(current);
+                current = parent[current];
+            }
+            // Reverse it so the cycle is in the correct order for recovery
+            reverse(cycle.begin(), cycle.end());
+            return true;
+        }
+    }
+
+    // removes node from stack after processing
+    recursionStack[node] = false;
+    return false;
+}
@@ -0,0 +1,46 @@
+#ifndef DEADLOCK_DETECTION_HPP
+#define DEADLOCK_DETECTION_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+// Wait-for graph between trains, stored as a dense adjacency list indexed by train id.
+// Cycles are found incrementally: after a train's out-edges change, only paths leading back to that train are searched.
+class WaitForGraph {
+    private:
+    vector<vector<int>> edges; // edges[u] = trains u is waiting on
+
+    // DFS scratch space, reused between searches. A node is visited when mark[node] == epoch.
+    vector<unsigned int> mark;
+    vector<int> parent;
+    vector<int> stack;
+    unsigned int epoch = 0;
+
+    public:
+    void resize(size_t numTrains);
+    size_t size() const;
+
+    void setEdges(int from, const vector<int>& to);
+    void clearEdges(int from);
+    const vector<int>& waitingOn(int node) const;
+    bool isWaiting(int node) const;
+
+    bool findCycleThrough(int node, vector<int>& cycle);
+    void clear();
+};
+
+bool detectDeadlock(const unordered_map<string, vector<string>>& waitingGraph, vector<string>& cycle);
+
+bool isCyclicUtil(const string& node,
+    unordered_map<string, bool>& visited,
+    unordered_map<string, bool>& recursionStack,
+    const unordered_map<string, vector<string>>& graph,
+    vector<string>& cycle,
+    unordered_map<string, string>& parent);
+
+#endif
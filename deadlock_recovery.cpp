@@ -4,53 +4,181 @@ Author: Evelyn Wilson
 Email: evelyn.wilson@okstate.edu
 Date: 4/12/2025
 
-Description: Resolving deadlocks by preempting an intersection in one of the active trains.
+Description: Resolving deadlocks by preempting one of the trains in the cycle. The victim is picked by a
+VictimPolicy from what each train really holds in the resource graph, then everything it holds is released
+and its queued request is dropped so it requests again.
 */
 
 #include "deadlock_recovery.hpp"
 
-void deadlockRecovery(unordered_map<string, Train*>& trains,
-    unordered_map<string, vector<string>>& resourceGraph,
-    const vector<string>& cycle, int sim_time) {
-    
-    writeLog logger;
+#include <cstring>
+
+// VICTIM_POLICY=fewest|progress|priority|cost, fewest by default
+VictimPolicy victimPolicyFromEnv() {
+    const char* policy = getenv("VICTIM_POLICY");
+    if (policy && strcmp(policy, "progress") == 0) {
+        return VICTIM_LEAST_PROGRESS;
+    }
+    if (policy && strcmp(policy, "priority") == 0) {
+        return VICTIM_LOWEST_PRIORITY;
+    }
+    if (policy && strcmp(policy, "cost") == 0) {
+        return VICTIM_LOWEST_COST;
+    }
+    return VICTIM_FEWEST_HELD;
+}
+
+const char* victim_policy_name(VictimPolicy policy) {
+    switch (policy) {
+        case VICTIM_FEWEST_HELD: return "fewest";
+        case VICTIM_LEAST_PROGRESS: return "progress";
+        case VICTIM_LOWEST_PRIORITY: return "priority";
+        case VICTIM_LOWEST_COST: return "cost";
+    }
+    return "unknown";
+}
+
+// Place on the train's route just past the furthest intersection it holds, 0 if it holds none on its route
+static size_t routeProgress(const Train* train, const vector<Intersection*>& held) {
+    size_t progress = 0;
+    for (size_t hop = 0; hop < train->route.size(); ++hop) {
+        uint32_t id = train->route[hop];
+        if (find_if(held.begin(), held.end(), [id](const Intersection* intersection) { return (uint32_t)intersection->id == id; }) != held.end()) {
+            progress = hop + 1;
+        }
+    }
+    return progress;
+}
+
+// Lower is a better victim. Ties go to whichever came first in the cycle.
+static long victimScore(VictimPolicy policy, const Train* train, const vector<Intersection*>& held) {
+    switch (policy) {
+        case VICTIM_LEAST_PROGRESS:
+            return routeProgress(train, held);
+        case VICTIM_LOWEST_PRIORITY:
+            return train->priority;
+        case VICTIM_LOWEST_COST: {
+            // Crossing time it has to give up and redo, a higher priority train costs more to preempt
+            long crossing = 0;
+            for (const Intersection* intersection : held) {
+                crossing += intersection->crossing_ms;
+            }
+            return crossing * (train->priority + 1);
+        }
+        case VICTIM_FEWEST_HELD:
+        default:
+            return held.size();
+    }
+}
+
+Preemption deadlockRecovery(vector<Train*>& trains,
+    ResourceAllocationGraph& resourceGraph,
+    const vector<int>& cycle, int sim_time, VictimPolicy policy) {
+    return deadlockRecovery(trains, vector<ResourceAllocationGraph*>{&resourceGraph}, cycle, sim_time, policy);
+}
+
+// The graph holding the intersection, nullptr if none does
+static ResourceAllocationGraph* graphOf(const vector<ResourceAllocationGraph*>& graphs, int intersectionId) {
+    for (ResourceAllocationGraph* graph : graphs) {
+        if (graph->getIntersection(intersectionId)) {
+            return graph;
+        }
+    }
+    return nullptr;
+}
+
+Preemption deadlockRecovery(vector<Train*>& trains,
+    const vector<ResourceAllocationGraph*>& graphs,
+    const vector<int>& cycle, int sim_time, VictimPolicy policy) {
 
+    writeLog logger;
+    Preemption preemption;
 
     // Check if the cycle is empty
     if (cycle.empty()) {
         logger.log("SERVER", "Deadlock recovery invoked, but no cycle detected.", sim_time);
-        return;
+        return preemption;
     }
-    
+
     // Make a string to log that shows the relationships between trains stuck in a cycle
     string cycleString;
     for (size_t i = 0; i < cycle.size(); ++i) {
-        cycleString += cycle[i];
-        if (i < cycle.size() - 1) cycleString += " : "; 
+        cycleString += trains[cycle[i]]->name; // names only come back for the log
+        if (i < cycle.size() - 1) cycleString += " : ";
     }
 
     logger.logDeadlockDetected(cycleString, sim_time);
 
-    /* Preempting train logic, releases it early so that another train can take its place and 
+    // What every train in the cycle holds, straight from the resource graphs' allocation tables
+    vector<vector<Intersection*>> held(cycle.size());
+    for (size_t i = 0; i < cycle.size(); ++i) {
+        for (ResourceAllocationGraph* graph : graphs) {
+            for (int id : graph->heldBy(cycle[i])) {
+                held[i].push_back(graph->getIntersection(id));
+            }
+        }
+    }
+
+    // Only a train that holds something frees anything up
+    int victim = -1;
+    long bestScore = 0;
+    for (size_t i = 0; i < cycle.size(); ++i) {
+        if (held[i].empty()) {
+            continue;
+        }
+        long score = victimScore(policy, trains[cycle[i]], held[i]);
+        if (victim == -1 || score < bestScore) {
+            victim = i;
+            bestScore = score;
+        }
+    }
+    if (victim == -1) {
+        logger.log("SERVER", "No train in the deadlock cycle holds an intersection. Skipping release.", sim_time);
+        return preemption;
+    }
+
+    /* Preempting train logic, releases everything it holds so that another train can take its place and
     the cycle is broken*/
-    
-    string preemptTrainName = cycle[0]; // Get the name of the first train in the cycle
-    Train* preemptTrain = trains[preemptTrainName]; // Find that train in the vector
-    Intersection* currentIntersection = preemptTrain->current_location; // Find the intersection it's in 
+    Train* preemptTrain = trains[cycle[victim]];
+    string preemptTrainName = preemptTrain->name;
+    preemption.train_id = preemptTrain->id;
+    logger.log("SERVER", "Preempting " + preemptTrainName + " (victim policy: " + victim_policy_name(policy) + ").", sim_time);
+
+    // Earliest on its route first, the PREEMPT names the first one released
+    vector<Intersection*>& victimHeld = held[victim];
+    stable_sort(victimHeld.begin(), victimHeld.end(), [preemptTrain](Intersection* a, Intersection* b) {
+        auto hopOf = [preemptTrain](Intersection* intersection) {
+            return find(preemptTrain->route.begin(), preemptTrain->route.end(), (uint32_t)intersection->id) - preemptTrain->route.begin();
+        };
+        return hopOf(a) < hopOf(b);
+    });
 
-    if (currentIntersection) { // If the current intersection is indeed a thing
+    for (Intersection* currentIntersection : victimHeld) {
         string intersectionName = currentIntersection->name; //Store the name of the intersection so it can be logged
         // Log that you're preempting a train
         logger.logPreemption(preemptTrainName, intersectionName, sim_time);
 
         // Release intersection
-        if (currentIntersection->release(preemptTrain)) {
+        if (graphOf(graphs, currentIntersection->id)->release(currentIntersection->id, preemptTrain)) {
             logger.logRelease(preemptTrainName, intersectionName, sim_time);
-            auto& holders = resourceGraph[intersectionName];
-            holders.erase(remove(holders.begin(), holders.end(), preemptTrainName), holders.end());
+            preemption.released.push_back(currentIntersection->id);
         }
-    } else {
-        logger.log("SERVER", "Preempted train has no current location. Skipping release.", sim_time);
     }
-}
 
+    // Drop its queued request, it asks again once it knows it was preempted
+    for (ResourceAllocationGraph* graph : graphs) {
+        for (int id = 0; id < graph->size(); ++id) {
+            Intersection* intersection = graph->getIntersection(id);
+            if (!intersection) {
+                continue;
+            }
+            auto queued = find(intersection->wait_queue.begin(), intersection->wait_queue.end(), preemptTrain);
+            if (queued != intersection->wait_queue.end()) {
+                intersection->wait_queue.erase(queued);
+                preemption.cancelled = id;
+            }
+        }
+    }
+
+    return preemption;
+}
@@ -10,11 +10,39 @@
 #include "train.hpp"
 #include "ipc.hpp"
 #include "parsing.hpp"
+#include "resource_allocation.hpp"
 
 using namespace std;
 
-void deadlockRecovery(unordered_map<string, Train*>& trains, 
-    unordered_map<string, vector<string>>& resourceGraph,
-    const vector<string>& cycle, int sim_time = 0);
+// How the train to preempt is picked from a deadlock cycle. Picked at runtime with VICTIM_POLICY.
+enum VictimPolicy {
+    VICTIM_FEWEST_HELD, // fewest: holds the fewest intersections (default)
+    VICTIM_LEAST_PROGRESS, // progress: furthest intersection it holds is earliest on its route
+    VICTIM_LOWEST_PRIORITY, // priority: lowest priority from trains.txt
+    VICTIM_LOWEST_COST, // cost: least crossing time held, weighted by priority
+};
 
-#endif
\ No newline at end of file
+// What recovery did to the victim, so the server can hand the intersections on and tell the train
+struct Preemption {
+    int train_id = -1; // Victim, -1 if nothing was preempted
+    vector<int> released; // Intersections taken back from it, earliest on its route first
+    int cancelled = -1; // Intersection whose wait queue it was taken out of, -1 if it wasn't queued
+};
+
+// trains is indexed by train id. Picks a victim from the cycle with the policy, releases everything it holds and
+// takes it out of the wait queue it is in. Granting the released intersections is left to the caller.
+Preemption deadlockRecovery(vector<Train*>& trains,
+    ResourceAllocationGraph& resourceGraph,
+    const vector<int>& cycle, int sim_time = 0,
+    VictimPolicy policy = VICTIM_FEWEST_HELD);
+
+// Same for a sharded server, where the intersections are split over several graphs and each id is in exactly one
+Preemption deadlockRecovery(vector<Train*>& trains,
+    const vector<ResourceAllocationGraph*>& graphs,
+    const vector<int>& cycle, int sim_time = 0,
+    VictimPolicy policy = VICTIM_FEWEST_HELD);
+
+VictimPolicy victimPolicyFromEnv();
+const char* victim_policy_name(VictimPolicy policy);
+
+#endif
@@ -0,0 +1,376 @@
+/*
+Group: B
+Author: Gavin Zlatar
+Email: gavin.zlatar@okstate.edu
+Date: 10/17/2026
+
+Description: Handles a single request from a train on the server side. ACQUIRE either grants the intersection or
+puts the train in the intersection's wait queue without replying, so the train just blocks on its response mtype.
+RELEASE frees the intersection and immediately pushes a GRANT to the next train in the queue. Used by both
+server.cpp and testserver.cpp so the two main loops stay in step. Trains and intersections are handled by id,
+names are only looked up when writing the log. Requests that arrive together are applied as one batch and deadlock
+detection runs once at the end of it. With DEADLOCK_MODE=avoid a grant that could lead to a deadlock is deferred
+instead, and retried whenever a release frees something up.
+*/
+
+#include "dispatch.hpp"
+
+// This will track what trains are waiting on what based on requests and grants
+WaitForGraph waitingGraph;
+ResourceAllocationGraph resourceGraph;
+
+// sim_time variable
+int sim_time = 0;
+
+// Totals for the current run
+SimulationStats simStats;
+
+DeadlockAvoidance avoidance;
+bool avoidDeadlocks = false;
+VictimPolicy victimPolicy = VICTIM_FEWEST_HELD;
+ServerMetrics serverMetrics;
+
+// Set by modes that don't run the trains as processes, see dispatch.hpp
+std::function<void(const msg_request&)> responseSink;
+bool externalClock = false;
+bool traceMessages = true;
+
+// Server side state of one train, indexed by train id
+struct TrainState {
+    uint32_t pendingSeq = 0; // Sequence number of the outstanding ACQUIRE, so a pushed GRANT answers the right request
+    int queuedSince = -1; // sim_time the train was queued at, -1 while it isn't waiting
+    std::chrono::steady_clock::time_point queuedAt;
+};
+static vector<TrainState> trainState;
+
+// Trains queued since deadlock detection last ran
+static vector<int> queuedTrains;
+
+// Intersections with a train whose grant was deferred as unsafe, retried after every release
+static vector<int> deferredAt;
+
+// Sends a response addressed to the train's own mtype, echoing the sequence number of the request it answers
+void sendResponse(uint8_t opcode, Train* train, int intersectionId, uint32_t seq) {
+    msg_request msg;
+    msg.mtype = TRAIN_REPLY_TYPE(train->id);
+    msg.opcode = opcode;
+    msg.seq = seq;
+    msg.train_id = train->id;
+    msg.intersection_id = intersectionId;
+    if (traceMessages) {
+        std::cout << "server.cpp: Sending message: " << msg.train_id << " " << opcode_name(msg.opcode) << " " << msg.intersection_id << " " << msg.mtype << std::endl;
+    }
+    if (responseSink) {
+        responseSink(msg);
+        return;
+    }
+    send_msg(responseQueueId, msg);
+}
+
+// Clears everything left over from an earlier run before a new one starts
+void resetDispatch(size_t numTrains) {
+    waitingGraph.clear();
+    waitingGraph.resize(numTrains);
+    trainState.assign(numTrains, TrainState());
+    queuedTrains.clear();
+    deferredAt.clear();
+    avoidance = DeadlockAvoidance();
+    avoidDeadlocks = avoidanceModeFromEnv();
+    victimPolicy = victimPolicyFromEnv();
+    serverMetrics.reset(getenv("METRICS_FILE") != nullptr, numTrains, resourceGraph.size());
+    sim_time = 0;
+    simStats = SimulationStats();
+    simStats.trains = numTrains;
+    responseSink = nullptr;
+    externalClock = false;
+    traceMessages = true;
+}
+
+// Gives the logger the names behind the ids it is handed, so the hot path can log by id
+void registerLogNames(const vector<Train*>& trains) {
+    vector<string> trainNames, intersectionNames;
+    for (Train* train : trains) {
+        trainNames.push_back(train->name);
+    }
+    for (int i = 0; i < resourceGraph.size(); ++i) {
+        intersectionNames.push_back(resourceGraph.getIntersection(i)->name);
+    }
+    writeLog::setNames(trainNames, intersectionNames);
+}
+
+// Logs the grant with the semaphore count and tells the train it can go
+static void grant(Train* train, Intersection* inter) {
+    int semaphore_count = -1;
+    if (!inter->is_mutex) {
+        semaphore_count = resourceGraph.freeUnits(inter->id); // Semaphore count is capacity - trains in intersection
+    }
+
+    writeLog::logGrant(train->id, inter->id, semaphore_count, sim_time);
+    sendResponse(OP_GRANT, train, inter->id, trainState[train->id].pendingSeq);
+    simStats.grants++;
+    serverMetrics.onGrant(train->id, inter->id);
+    if (simStats.firstRecoveryAt >= 0) {
+        simStats.grantsAfterRecovery++;
+    }
+    if (avoidDeadlocks) {
+        avoidance.onGrant(train->id, inter->id);
+    }
+
+    // Add the time it spent queued to the wait totals
+    TrainState& state = trainState[train->id];
+    if (state.queuedSince >= 0) {
+        simStats.waitTime += sim_time - state.queuedSince;
+        simStats.waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - state.queuedAt).count();
+        state.queuedSince = -1;
+    }
+
+    waitingGraph.clearEdges(train->id); // Remove the train from the waitingGraph.
+}
+
+// Every train in the wait queue is waiting on whoever currently holds the intersection
+void refreshWaitEdges(int intersectionId) {
+    Intersection* inter = resourceGraph.getIntersection(intersectionId);
+    vector<int> waitingOn;
+    for (Train* waiter : inter->wait_queue) {
+        waitingOn.clear();
+        for (int holderId : resourceGraph.holders(intersectionId)) {
+            if (holderId != waiter->id) {
+                waitingOn.push_back(holderId);
+            }
+        }
+        waitingGraph.setEdges(waiter->id, waitingOn);
+    }
+}
+
+// Tells the victim what recovery took from it and hands those intersections to the trains waiting for them.
+// The PREEMPT answers the victim's dropped ACQUIRE, and the victim asks for the same intersection again.
+static void preempt(Train* victim, const Preemption& preemption) {
+    TrainState& state = trainState[victim->id];
+    state.queuedSince = -1;
+    waitingGraph.clearEdges(victim->id);
+    simStats.preemptions++;
+    if (simStats.firstRecoveryAt < 0) {
+        simStats.firstRecoveryAt = sim_time;
+    }
+    if (avoidDeadlocks) {
+        for (int intersectionId : preemption.released) {
+            avoidance.onPreempt(victim->id, intersectionId);
+        }
+    }
+    for (int intersectionId : preemption.released) {
+        serverMetrics.onRelease(victim->id, intersectionId);
+    }
+
+    sendResponse(OP_PREEMPT, victim, preemption.released.front(), state.pendingSeq);
+    for (int intersectionId : preemption.released) {
+        grantWaiters(intersectionId);
+    }
+    if (preemption.cancelled != -1) {
+        refreshWaitEdges(preemption.cancelled);
+    }
+}
+
+// Runs after a train is queued. Only the edges it just added can close a new cycle, so the search
+// starts and ends at that train instead of walking the whole graph on every message.
+void checkForDeadlock(Train* train, vector<Train*>& trains) {
+    vector<int> cycle;
+    if (!waitingGraph.findCycleThrough(train->id, cycle)) {
+        return;
+    }
+
+    std::cout << "Deadlock detected! Handing over to the recovery module...\n";
+    simStats.deadlocks++;
+
+    std::chrono::steady_clock::time_point recoveryStart = std::chrono::steady_clock::now();
+    Preemption preemption = deadlockRecovery(trains, resourceGraph, cycle, sim_time, victimPolicy);
+    if (preemption.train_id != -1 && !preemption.released.empty()) {
+        preempt(trains[preemption.train_id], preemption);
+    }
+    serverMetrics.onDeadlock(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - recoveryStart).count());
+}
+
+static void markDeferred(int intersectionId) {
+    if (std::find(deferredAt.begin(), deferredAt.end(), intersectionId) == deferredAt.end()) {
+        deferredAt.push_back(intersectionId);
+    }
+}
+
+// Pushes GRANTs to queued trains for as long as the intersection has room
+void grantWaiters(int intersectionId) {
+    Intersection* inter = resourceGraph.getIntersection(intersectionId);
+    if (avoidDeadlocks) {
+        // Grant waiters in queue order, skipping any whose grant would be unsafe so it can't hold up the rest
+        size_t position = 0;
+        while (position < inter->wait_queue.size() && resourceGraph.isOpen(inter->id)) {
+            Train* next = inter->wait_queue[position];
+            if (!avoidance.isSafeToGrant(next->id, intersectionId)) {
+                markDeferred(intersectionId);
+                position++;
+                continue;
+            }
+            resourceGraph.grantQueued(intersectionId, position);
+            grant(next, inter);
+        }
+    } else {
+        while (Train* next = resourceGraph.grantNext(intersectionId)) {
+            grant(next, inter);
+        }
+    }
+    refreshWaitEdges(intersectionId);
+}
+
+// A release anywhere can make a deferred grant safe, so give every intersection holding one another go
+void retryDeferred() {
+    for (size_t i = 0; i < deferredAt.size(); ++i) {
+        grantWaiters(deferredAt[i]);
+    }
+    deferredAt.erase(std::remove_if(deferredAt.begin(), deferredAt.end(), [](int intersectionId) {
+        return resourceGraph.getIntersection(intersectionId)->wait_queue.empty();
+    }), deferredAt.end());
+}
+
+// Runs detection for every train queued since the last call. Trains that were granted in the meantime aren't
+// waiting any more and can't be part of a cycle, so they are skipped.
+void detectQueuedDeadlocks(vector<Train*>& trains) {
+    for (int trainId : queuedTrains) {
+        if (waitingGraph.isWaiting(trainId)) {
+            checkForDeadlock(trains[trainId], trains);
+        }
+    }
+    queuedTrains.clear();
+}
+
+// Applies one request to the resource graph without running deadlock detection. Returns true when the train
+// reports its route is complete.
+static bool applyRequest(msg_request& msg, vector<Train*>& trains) {
+    // look up the train and intersection by id, the ids come straight off the message queue so check them
+    if (msg.train_id < 0 || (size_t)msg.train_id >= trains.size()) {
+        writeLog::log("SERVER", "Invalid request: Unknown train id " + std::to_string(msg.train_id), sim_time);
+        std::cerr << "server.cpp: Invalid request: Unknown train id " << msg.train_id << std::endl;
+        return false;
+    }
+    Train* train = trains[msg.train_id];
+    Intersection* inter = resourceGraph.getIntersection(msg.intersection_id);
+    serverMetrics.onRequest();
+    if (trainState.size() != trains.size()) {
+        trainState.assign(trains.size(), TrainState());
+    }
+    if (avoidDeadlocks && avoidance.size() != trains.size()) {
+        avoidance.reset(trains, resourceGraph);
+    }
+
+    switch (msg.opcode) {
+    case OP_ACQUIRE:
+        if (!inter) {
+            writeLog::log("SERVER", "Invalid acquire request: Intersection not found: " + std::to_string(msg.intersection_id), sim_time);
+            std::cerr << "server.cpp: Invalid acquire request: Intersection not found: " << msg.intersection_id << std::endl;
+            sendResponse(OP_DENY, train, msg.intersection_id, msg.seq);
+            return false;
+        }
+
+        trainState[train->id].pendingSeq = msg.seq; // Answered now by a GRANT or later when a release pushes one
+        serverMetrics.onAcquire(train->id);
+
+        if (!externalClock) {
+            sim_time++; // Without a real clock every request is one tick
+        }
+        writeLog::logTrainRequest(train->id, inter->id, sim_time);
+        if (avoidDeadlocks && resourceGraph.isOpen(inter->id)) {
+            // Goes through the queue so a deferred train ahead of it can't hold up a train that is safe to grant
+            resourceGraph.enqueue(inter->id, train);
+            trainState[train->id].queuedSince = sim_time;
+            trainState[train->id].queuedAt = std::chrono::steady_clock::now();
+            grantWaiters(inter->id);
+            if (std::find(inter->wait_queue.begin(), inter->wait_queue.end(), train) != inter->wait_queue.end()) {
+                writeLog::log("SERVER", "Deferred " + train->name + " at " + inter->name + ", granting it now could deadlock.", sim_time);
+                simStats.deferred++;
+                serverMetrics.onWait(inter->id);
+            }
+        } else if (resourceGraph.acquire(inter->id, train)) {
+            // log success and grant access
+            grant(train, inter);
+        } else {
+            // log fail and queue the train, it stays blocked until a release grants it the intersection
+            writeLog::logLock(train->id, inter->id, sim_time);
+            serverMetrics.onWait(inter->id);
+            resourceGraph.enqueue(inter->id, train);
+            trainState[train->id].queuedSince = sim_time;
+            trainState[train->id].queuedAt = std::chrono::steady_clock::now();
+            refreshWaitEdges(inter->id);
+            queuedTrains.push_back(train->id);
+        }
+        break;
+
+    case OP_RELEASE: {
+        bool success = inter && resourceGraph.release(inter->id, train);
+        if (success) {
+            // log success, cancel wait, and hand the intersection to the next train in line
+            writeLog::logRelease(train->id, inter->id, sim_time);
+            serverMetrics.onRelease(train->id, inter->id);
+
+            waitingGraph.clearEdges(train->id);
+            if (avoidDeadlocks) {
+                avoidance.onRelease(train->id, inter->id);
+            }
+            grantWaiters(inter->id);
+            if (avoidDeadlocks) {
+                retryDeferred();
+            }
+        }
+        else
+        {
+            resourceGraph.printGraph(); // Print the resource graph for debugging
+            // log invalid request and deny it
+            if (!inter)
+            {
+                writeLog::log("SERVER", "Invalid release request: Intersection not found: " + std::to_string(msg.intersection_id), sim_time);
+                std::cerr << "server.cpp: Invalid release request: Intersection not found: " << msg.intersection_id << std::endl;
+            }
+            else if (!resourceGraph.holds(inter->id, train->id))
+            {
+                writeLog::log("SERVER", "Invalid release request: Train " + train->name + " not found in intersection " + inter->name, sim_time);
+                std::cerr << "server.cpp: Invalid release request: Train " << train->name << " not found in intersection " << inter->name << std::endl;
+            }
+            else
+            {
+                writeLog::log("SERVER", "Invalid release request: Unknown error for train " + train->name + " at intersection " + inter->name, sim_time);
+                std::cerr << "server.cpp: Invalid release request: Unknown error for train " << train->name << " at intersection " << inter->name << std::endl;
+            }
+            // sends response message to train
+            sendResponse(OP_DENY, train, msg.intersection_id, msg.seq);
+        }
+        break;
+    }
+
+    case OP_COMPLETE:
+        // Train has completed its route
+        return true;
+
+    default:
+        writeLog::log("SERVER", "Invalid request: Unknown opcode " + std::to_string(msg.opcode) + " from " + train->name, sim_time);
+        std::cerr << "server.cpp: Invalid request: Unknown opcode " << (int)msg.opcode << " from " << train->name << std::endl;
+        break;
+    }
+
+    return false;
+}
+
+// Applies one request and checks it for deadlock. Returns true when the train reports its route is complete.
+bool handleRequest(msg_request& msg, vector<Train*>& trains) {
+    bool complete = applyRequest(msg, trains);
+    detectQueuedDeadlocks(trains);
+    return complete;
+}
+
+// Applies a whole batch of requests in arrival order, sending each response as it goes, then runs deadlock
+// detection once for the batch. Returns how many trains reported their route complete.
+int handleBatch(vector<msg_request>& batch, vector<Train*>& trains) {
+    int completed = 0;
+    for (msg_request& msg : batch) {
+        if (applyRequest(msg, trains)) {
+            completed++;
+        }
+    }
+    detectQueuedDeadlocks(trains);
+    return completed;
+}
@@ -0,0 +1,78 @@
+#ifndef DISPATCH_HPP
+#define DISPATCH_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <functional>
+#include "parsing.hpp"
+#include "logging.hpp"
+#include "ipc.hpp"
+#include "resource_allocation.hpp"
+#include "deadlock_detection.hpp"
+#include "deadlock_recovery.hpp"
+#include "deadlock_avoidance.hpp"
+#include "metrics.hpp"
+
+using namespace std;
+
+// Totals for one run, printed by the runner
+struct SimulationStats {
+    int trains = 0;
+    int makespan = 0; // sim_time when the last train completed
+    int grants = 0;
+    int deadlocks = 0;
+    int deferred = 0; // Grants held back because they were unsafe, DEADLOCK_MODE=avoid only
+    int preemptions = 0;
+    int firstRecoveryAt = -1; // sim_time of the first preemption, -1 if there wasn't one
+    int grantsAfterRecovery = 0; // Grants from then on, for throughput after recovery
+    long waitTime = 0; // sim_time trains spent queued, summed over every train
+    double waitSeconds = 0; // Same in real time
+    double wallSeconds = 0; // Real time for the whole run
+};
+
+// Server state shared by server.cpp and testserver.cpp
+extern WaitForGraph waitingGraph;
+extern ResourceAllocationGraph resourceGraph;
+extern int sim_time;
+extern SimulationStats simStats;
+
+// With avoidDeadlocks (DEADLOCK_MODE=avoid, read by resetDispatch) every grant must pass the avoidance check first
+extern DeadlockAvoidance avoidance;
+extern bool avoidDeadlocks;
+
+// Victim policy for deadlock recovery, VICTIM_POLICY read by resetDispatch
+extern VictimPolicy victimPolicy;
+
+// Latency histograms and counters for METRICS_FILE, enabled and sized by resetDispatch
+extern ServerMetrics serverMetrics;
+
+// For modes where the trains don't run as processes, all reset by resetDispatch:
+// responseSink takes responses instead of the response queue, externalClock stops handleRequest from ticking
+// sim_time because the caller sets it, and traceMessages turns off the per-message console output.
+extern std::function<void(const msg_request&)> responseSink;
+extern bool externalClock;
+extern bool traceMessages;
+
+void resetDispatch(size_t numTrains);
+
+bool handleRequest(msg_request& msg, vector<Train*>& trains);
+
+int handleBatch(vector<msg_request>& batch, vector<Train*>& trains);
+
+void detectQueuedDeadlocks(vector<Train*>& trains);
+
+void registerLogNames(const vector<Train*>& trains);
+
+void sendResponse(uint8_t opcode, Train* train, int intersectionId, uint32_t seq);
+
+void grantWaiters(int intersectionId);
+
+void retryDeferred();
+
+void refreshWaitEdges(int intersectionId);
+
+void checkForDeadlock(Train* train, vector<Train*>& trains);
+
+#endif
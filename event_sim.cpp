@@ -0,0 +1,205 @@
+/*
+Group: B
+Author: Gavin Zlatar
+Email: gavin.zlatar@okstate.edu
+Date: 10/17/2026
+
+Description: Discrete event version of the simulation. Each train's behaviour from train.cpp (request the next
+intersection, cross it once granted, release it, move on) is replayed as events on a priority queue ordered by
+simulated time, and the requests go through the same handleRequest as the real server. Nothing sleeps: the clock
+jumps to the next event, so sim_time in the log is real simulated seconds and a large scenario runs in milliseconds.
+Departure, travel and crossing times come from the config, the clock counts milliseconds so they are kept exactly.
+*/
+
+#include "event_sim.hpp"
+
+// SIM_MODE=event picks the event driven mode
+bool eventModeFromEnv() {
+    const char* mode = getenv("SIM_MODE");
+    return mode && strcmp(mode, "event") == 0;
+}
+
+// Event queue plus what each train is doing
+class EventSimulation {
+    private:
+    std::priority_queue<SimEvent, vector<SimEvent>, LaterEvent> events;
+    unsigned long scheduled = 0;
+    vector<Train*>& trains;
+    vector<size_t> hop; // Index into each train's route of the intersection it is at or heading to
+    vector<uint32_t> seq;
+    long now = 0; // Time of the event being run, in milliseconds
+
+    void sendRequest(uint8_t opcode, int trainId, int intersectionId) {
+        msg_request msg;
+        msg.mtype = MSG_TYPE_DEFAULT;
+        msg.opcode = opcode;
+        msg.seq = ++seq[trainId];
+        msg.train_id = trainId;
+        msg.intersection_id = intersectionId;
+        if (handleRequest(msg, trains)) {
+            completed++;
+        }
+    }
+
+    int currentIntersection(int trainId) {
+        return trains[trainId]->route[hop[trainId]];
+    }
+
+    public:
+    int completed = 0;
+    long metricsEveryMs = 0; // Simulated time between metrics dumps, none if 0
+    std::function<void()> dumpMetrics;
+
+    EventSimulation(vector<Train*>& trains) : trains(trains), hop(trains.size(), 0), seq(trains.size(), 0) {
+    }
+
+    void schedule(long time, SimEventType type, int trainId) {
+        events.push({time, scheduled++, type, trainId});
+    }
+
+    // Travel time to the train's next hop, nothing once its route is done
+    unsigned int travelTime(int trainId) {
+        const Train* train = trains[trainId];
+        return hop[trainId] < train->route.size() ? train->travel_ms[hop[trainId]] : 0;
+    }
+
+    // The server's responses come back here instead of going to a queue
+    void onResponse(const msg_request& msg) {
+        if (msg.opcode == OP_GRANT) {
+            schedule(now, EV_GRANT, msg.train_id);
+        } else if (msg.opcode == OP_DENY) {
+            schedule(now + TRAIN_RETRY_MS, EV_REQUEST, msg.train_id);
+        } else if (msg.opcode == OP_PREEMPT) {
+            // Its request was dropped. It released every intersection before asking for this one, so it asks again.
+            schedule(now + TRAIN_RETRY_MS, EV_REQUEST, msg.train_id);
+        }
+        // WAIT needs nothing, the GRANT arrives once the train is at the front of the queue
+    }
+
+    // Runs events until none are left. Returns false if some train never finished.
+    bool run() {
+        long nextDumpMs = metricsEveryMs;
+        while (!events.empty()) {
+            SimEvent event = events.top();
+            events.pop();
+            now = event.time;
+            sim_time = now / 1000;
+            // Dumped on the simulated clock, with what happened up to the interval the clock just passed
+            if (metricsEveryMs > 0 && now >= nextDumpMs) {
+                dumpMetrics();
+                nextDumpMs = (now / metricsEveryMs + 1) * metricsEveryMs;
+            }
+            int id = event.train_id;
+
+            switch (event.type) {
+            case EV_ARRIVE:
+                if (hop[id] >= trains[id]->route.size()) {
+                    schedule(now, EV_COMPLETE, id);
+                } else {
+                    schedule(now, EV_REQUEST, id);
+                }
+                break;
+            case EV_REQUEST:
+                sendRequest(OP_ACQUIRE, id, currentIntersection(id));
+                break;
+            case EV_GRANT:
+                schedule(now + resourceGraph.getIntersection(currentIntersection(id))->crossing_ms, EV_RELEASE, id);
+                break;
+            case EV_RELEASE:
+                sendRequest(OP_RELEASE, id, currentIntersection(id));
+                hop[id]++;
+                schedule(now + travelTime(id), EV_ARRIVE, id);
+                break;
+            case EV_COMPLETE:
+                sendRequest(OP_COMPLETE, id, -1);
+                break;
+            }
+        }
+        return completed == (int)trains.size();
+    }
+};
+
+int runEventDriven(const std::string& intersectionsPath, const std::string& trainsPath) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Initialize the resource graph
+    resourceGraph = ResourceAllocationGraph();
+
+    // parse for intersections and train configs, or map them from a compiled topology with TOPOLOGY_FILE. The
+    // objects live in the arena and go with it when this returns, trains from a topology run off its mapping.
+    Topology topology;
+    NetworkArena arena;
+    vector<Intersection*> intersections;
+    vector<Train*> trainsList;
+    if (!loadNetwork(intersectionsPath, trainsPath, topology, arena, intersections, trainsList)) {
+        std::cerr << "event_sim.cpp: Failed to load the network.\n";
+        return 1;
+    }
+
+    for (Intersection* inter : intersections) {
+        resourceGraph.addIntersection(inter);
+    }
+
+    resetDispatch(trainsList.size());
+    registerLogNames(trainsList);
+    writeLog::configureFromEnv();
+
+    // With METRICS_FILE set the metrics are written every METRICS_INTERVAL_MS of simulated time and once at the
+    // end. Requests never wait in a queue here, so the queue depth is always 0.
+    MetricsReporter metrics;
+    std::vector<const ServerMetrics*> metricsSources{&serverMetrics};
+    std::vector<std::string> intersectionNames;
+    if (metrics.configureFromEnv()) {
+        for (Intersection* inter : intersections) {
+            intersectionNames.push_back(inter->name);
+        }
+    }
+
+    EventSimulation simulation(trainsList);
+    if (metrics.isEnabled()) {
+        simulation.metricsEveryMs = metrics.intervalMs();
+        simulation.dumpMetrics = [&]() { metrics.dump(metricsSources, intersectionNames, sim_time, 0); };
+    }
+    responseSink = [&simulation](const msg_request& msg) { simulation.onResponse(msg); };
+    externalClock = true;
+    traceMessages = false;
+
+    std::ostringstream intersectionLog;
+    intersectionLog << "Initialized intersections:\n";
+    for (Intersection* inter : intersections)
+    {
+        intersectionLog << "- " << inter->name << " (";
+        intersectionLog << (inter->is_mutex ? "Mutex" : "Semaphore") << ", Capacity=" << inter->capacity << ")\n";
+    }
+    writeLog::log("SERVER", intersectionLog.str(), sim_time);
+
+    // Every train reaches its first intersection after its departure and travel time, ties in id order like the
+    // forked trains start
+    for (Train* train : trainsList) {
+        simulation.schedule(train->departure_ms + simulation.travelTime(train->id), EV_ARRIVE, train->id);
+    }
+
+    bool finished = simulation.run();
+    metrics.dump(metricsSources, intersectionNames, sim_time, 0);
+    simStats.makespan = sim_time;
+    if (finished) {
+        writeLog::logSimulationComplete(sim_time);
+        std::cout << "event_sim.cpp: All trains have completed their routes at sim_time " << sim_time << ".\n";
+    } else {
+        // Nothing left to happen but trains are still waiting, so a deadlock was never resolved
+        writeLog::log("SERVER", "Simulation stalled with " + std::to_string(trainsList.size() - simulation.completed) + " trains unfinished.", sim_time);
+        writeLog::stopAsync();
+        writeLog::stopBinary();
+        std::cerr << "event_sim.cpp: Simulation stalled at sim_time " << sim_time << " with "
+                  << trainsList.size() - simulation.completed << " trains unfinished.\n";
+    }
+
+    // Back to the response queue for whatever runs next
+    responseSink = nullptr;
+    externalClock = false;
+    traceMessages = true;
+    resourceGraph = ResourceAllocationGraph();
+    simStats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return finished ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#ifndef EVENT_SIM_HPP
+#define EVENT_SIM_HPP
+
+#include <string>
+#include <vector>
+#include <queue>
+#include "parsing.hpp"
+#include "dispatch.hpp"
+#include "train.hpp"
+#include "topology.hpp"
+
+enum SimEventType {
+    EV_ARRIVE, // Train reaches its next intersection
+    EV_REQUEST, // Train sends ACQUIRE for it
+    EV_GRANT, // Server's GRANT reaches the train, it starts crossing
+    EV_RELEASE, // Train has crossed and sends RELEASE
+    EV_COMPLETE, // Train reports its route is complete
+};
+
+struct SimEvent {
+    long time; // Simulated milliseconds, sim_time is this in whole seconds
+    unsigned long order; // Ties at the same time run in the order they were scheduled
+    SimEventType type;
+    int train_id;
+};
+
+// Orders the priority queue earliest first
+struct LaterEvent {
+    bool operator()(const SimEvent& a, const SimEvent& b) const {
+        return a.time != b.time ? a.time > b.time : a.order > b.order;
+    }
+};
+
+// Event driven mode (SIM_MODE=event): trains are replayed from a priority queue of timestamped events instead of
+// running as processes, so simulated time jumps straight to the next event. Returns 0 once every train completes.
+int runEventDriven(const std::string& intersectionsPath, const std::string& trainsPath);
+
+bool eventModeFromEnv();
+
+#endif
@@ -11,7 +11,7 @@ Description:
 
 // Create message queues
 
-// Store the mutexes and semaphores, set the values to match specified capacities
+// Lay out the request and response rings in the shared memory for IPC_TRANSPORT=shm
 
 #include "ipc.hpp"
 
@@ -24,31 +24,104 @@ key_t key_mem = -1; // Key: shared memory
 key_t key_req = -1; // Key: request queue
 key_t key_res = -1; // Key: response queue
 
+IpcTransport ipc_transport = TRANSPORT_MSGQ;
+std::string ipc_key_prefix = IPC_KEY_PREFIX;
+static ShmChannels* channels = nullptr; // Attached before the trains fork, so every train inherits the mapping
+
+// TRANSPORT_INPROC request queue
+static std::mutex inprocMutex;
+static std::condition_variable inprocReady;
+static std::deque<msg_request> inprocRequests;
+
 // TODO: initialize resource allocation graph and functions
 
-int ipc_setup() {
+// Reads IPC_TRANSPORT, anything other than "shm" keeps the message queues
+IpcTransport ipc_transport_from_env() {
+    const char* value = getenv("IPC_TRANSPORT");
+    if (value && strcmp(value, "shm") == 0) {
+        return TRANSPORT_SHM;
+    }
+    return TRANSPORT_MSGQ;
+}
+
+const char* transport_name(IpcTransport transport) {
+    switch (transport) {
+        case TRANSPORT_SHM: return "shared memory rings";
+        case TRANSPORT_INPROC: return "in-process queue";
+        default: return "message queues";
+    }
+}
+
+// Request ring followed by one response ring per train
+size_t shm_channels_size(int numTrains) {
+    return sizeof(ShmChannels) + (size_t)numTrains * sizeof(ResponseRing);
+}
+
+static ResponseRing* response_ring(long mtype) {
+    long index = mtype - MSG_TYPE_TRAIN_BASE;
+    if (index < 0 || index >= (long)channels->numTrains) {
+        return nullptr;
+    }
+    return reinterpret_cast<ResponseRing*>(reinterpret_cast<char*>(channels) + sizeof(ShmChannels)) + index;
+}
+
+// numTrains sizes the response rings when the shared memory transport is used
+int ipc_setup(int numTrains, IpcTransport transport) {
     // Create paths for shared memory and message queues
+    std::string shm_key_path = ipc_key_prefix + "_shm";
+    std::string mq_request_key_path = ipc_key_prefix + "_req";
+    std::string mq_response_key_path = ipc_key_prefix + "_res";
     std::ofstream(shm_key_path).close();
     std::ofstream(mq_request_key_path).close();
     std::ofstream(mq_response_key_path).close();
 
     // Keys for shared memory and queues
-    key_t key_mem = ftok(shm_key_path, 'M');
-    key_t key_req = ftok(mq_request_key_path, 'R');
-    key_t key_res = ftok(mq_response_key_path, 'S');
+    key_mem = ftok(shm_key_path.c_str(), 'M');
+    key_req = ftok(mq_request_key_path.c_str(), 'R');
+    key_res = ftok(mq_response_key_path.c_str(), 'S');
 
     if (key_req == -1 || key_res == -1 || key_mem == -1) {
         perror("ftok");
         return -1;
     }
 
+    // Drop the segment from an earlier run, its size depends on the transport and the number of trains
+    if (channels) {
+        shmdt(channels);
+        channels = nullptr;
+    }
+    int oldShmid = shmget(key_mem, 0, 0666);
+    if (oldShmid != -1) {
+        shmctl(oldShmid, IPC_RMID, nullptr);
+    }
+
     // Creates shared memory
-    int shmid = shmget(key_mem, SHARED_MEMORY_SIZE, 0666 | IPC_CREAT);
+    size_t shmSize = transport == TRANSPORT_SHM ? shm_channels_size(numTrains) : SHARED_MEMORY_SIZE;
+    shmid = shmget(key_mem, shmSize, 0666 | IPC_CREAT);
     if (shmid == -1){
         perror("shmget (Create)");
         return -1;
     }
 
+    if (transport == TRANSPORT_SHM) {
+        void* memory = shmat(shmid, nullptr, 0);
+        if (memory == (void*)-1) {
+            perror("shmat");
+            return -1;
+        }
+        channels = static_cast<ShmChannels*>(memory);
+        channels->numTrains = numTrains;
+        channels->requests.init();
+        for (int i = 0; i < numTrains; ++i) {
+            response_ring(TRAIN_REPLY_TYPE(i))->init();
+        }
+    }
+    if (transport == TRANSPORT_INPROC) {
+        std::lock_guard<std::mutex> lock(inprocMutex);
+        inprocRequests.clear();
+    }
+    ipc_transport = transport;
+
     // Creates request and response message queues
     requestQueueId = msgget(key_req, 0666 | IPC_CREAT);
     responseQueueId = msgget(key_res, 0666 | IPC_CREAT);
@@ -60,7 +133,7 @@ int ipc_setup() {
 
     // Clear all messages in the request queue
     msg_request temp_msg;
-    while (msgrcv(requestQueueId, &temp_msg, sizeof(temp_msg) - sizeof(long), 0, IPC_NOWAIT) != -1) {
+    while (msgrcv(requestQueueId, &temp_msg, sizeof(temp_msg) - sizeof(long), 0, IPC_NOWAIT | MSG_NOERROR) != -1) {
         std::cout << "ipc.cpp: Cleared a message from the request queue.\n";
     }
     if (errno != ENOMSG) {
@@ -70,7 +143,7 @@ int ipc_setup() {
     std::cout << "ipc.cpp: Request queue is now empty.\n";
 
     // Clear all messages in the response queue
-    while (msgrcv(responseQueueId, &temp_msg, sizeof(temp_msg) - sizeof(long), 0, IPC_NOWAIT) != -1) {
+    while (msgrcv(responseQueueId, &temp_msg, sizeof(temp_msg) - sizeof(long), 0, IPC_NOWAIT | MSG_NOERROR) != -1) {
         std::cout << "ipc.cpp: Cleared a message from the response queue.\n";
     }
     if (errno != ENOMSG) {
@@ -80,13 +153,44 @@ int ipc_setup() {
 
     std::cout << "ipc.cpp: Request Queue ID: " << requestQueueId << std::endl;
     std::cout << "ipc.cpp: Response Queue ID: " << responseQueueId << std::endl;
+    std::cout << "ipc.cpp: Transport: " << transport_name(ipc_transport) << std::endl;
 
     return 0;
 }
 
-// Sends message to the queue
+// Sends message to the queue, stamped with this build's wire format
+// With the shared memory transport the request queue maps to the request ring and responses go to the ring of the
+// train named by mtype. Neither makes a syscall unless the other side is asleep.
 int send_msg(int msgid, const msg_request& msg) {
-    int ret = msgsnd(msgid, &msg, sizeof(msg_request) - sizeof(long), 0);
+    msg_request frame = msg;
+    frame.magic = MSG_MAGIC;
+    frame.version = MSG_VERSION;
+    if (ipc_transport == TRANSPORT_INPROC) {
+        if (msgid != requestQueueId) {
+            std::cerr << "ipc.cpp: In-process transport only carries requests" << std::endl;
+            return -1;
+        }
+        {
+            std::lock_guard<std::mutex> lock(inprocMutex);
+            inprocRequests.push_back(frame);
+        }
+        inprocReady.notify_one();
+        return 0;
+    }
+    if (ipc_transport == TRANSPORT_SHM) {
+        if (msgid == requestQueueId) {
+            channels->requests.push(frame);
+            return 0;
+        }
+        ResponseRing* ring = response_ring(frame.mtype);
+        if (!ring) {
+            std::cerr << "ipc.cpp: No response ring for mtype " << frame.mtype << std::endl;
+            return -1;
+        }
+        ring->push(frame);
+        return 0;
+    }
+    int ret = msgsnd(msgid, &frame, sizeof(msg_request) - sizeof(long), 0);
     // Check if message was sent successfully
     if (ret == -1) {
         perror("ipc.cpp: msgsnd failed");
@@ -94,38 +198,234 @@ int send_msg(int msgid, const msg_request& msg) {
     return ret;
 }
 
+// A frame is only accepted if it is exactly our size and carries our magic and version
+bool valid_msg(const msg_request& msg, size_t received) {
+    return received == sizeof(msg_request) - sizeof(long) && msg.magic == MSG_MAGIC && msg.version == MSG_VERSION;
+}
+
 // Receives message from the queue
+// Only messages of the given mtype are delivered, so a train passing its own reply type never picks up another train's response
+// Frames from a build with a different wire format are dropped with a warning and the next one is read instead.
+// MSG_NOERROR truncates a larger foreign frame rather than leaving it stuck at the front of the queue.
 int receive_msg(int msgid, msg_request& msg, long mtype) {
-    int ret = msgrcv(msgid, &msg, sizeof(msg_request) - sizeof(long), mtype, 0);
-    // Check if message was received successfully
-    if (ret == -1) {
-        perror("ipc.cpp: msgsnd failed");
+    if (ipc_transport == TRANSPORT_INPROC && msgid == requestQueueId) {
+        std::unique_lock<std::mutex> lock(inprocMutex);
+        inprocReady.wait(lock, [] { return !inprocRequests.empty(); });
+        msg = inprocRequests.front();
+        inprocRequests.pop_front();
+        return sizeof(msg_request) - sizeof(long);
+    }
+    if (ipc_transport == TRANSPORT_SHM) {
+        if (msgid == requestQueueId) {
+            channels->requests.pop(msg);
+            return sizeof(msg_request) - sizeof(long);
+        }
+        ResponseRing* ring = response_ring(mtype);
+        if (!ring) {
+            std::cerr << "ipc.cpp: No response ring for mtype " << mtype << std::endl;
+            return -1;
+        }
+        ring->pop(msg);
+        return sizeof(msg_request) - sizeof(long);
+    }
+    while (true) {
+        int ret = msgrcv(msgid, &msg, sizeof(msg_request) - sizeof(long), mtype, MSG_NOERROR);
+        if (ret == -1 && errno == EINTR) {
+            continue; // Retry if interrupted by a signal
+        }
+        // Check if message was received successfully
+        if (ret == -1) {
+            perror("ipc.cpp: msgrcv failed");
+            return ret;
+        }
+        if (valid_msg(msg, ret)) {
+            return ret;
+        }
+        std::cerr << "ipc.cpp: Rejected frame with unknown wire format (" << ret << " bytes, magic " << std::hex << msg.magic << std::dec << ", version " << (int)msg.version << ")" << std::endl;
+    }
+}
+
+// Same as receive_msg but returns -1 with errno ENOMSG straight away when nothing is waiting
+int try_receive_msg(int msgid, msg_request& msg, long mtype) {
+    if (ipc_transport == TRANSPORT_INPROC && msgid == requestQueueId) {
+        std::lock_guard<std::mutex> lock(inprocMutex);
+        if (inprocRequests.empty()) {
+            errno = ENOMSG;
+            return -1;
+        }
+        msg = inprocRequests.front();
+        inprocRequests.pop_front();
+        return sizeof(msg_request) - sizeof(long);
+    }
+    if (ipc_transport == TRANSPORT_SHM) {
+        bool popped;
+        if (msgid == requestQueueId) {
+            popped = channels->requests.tryPop(msg);
+        } else {
+            ResponseRing* ring = response_ring(mtype);
+            if (!ring) {
+                std::cerr << "ipc.cpp: No response ring for mtype " << mtype << std::endl;
+                return -1;
+            }
+            popped = ring->tryPop(msg);
+        }
+        if (!popped) {
+            errno = ENOMSG;
+            return -1;
+        }
+        return sizeof(msg_request) - sizeof(long);
+    }
+    while (true) {
+        int ret = msgrcv(msgid, &msg, sizeof(msg_request) - sizeof(long), mtype, IPC_NOWAIT | MSG_NOERROR);
+        if (ret == -1 && errno == EINTR) {
+            continue; // Retry if interrupted by a signal
+        }
+        if (ret == -1) {
+            if (errno != ENOMSG) {
+                perror("ipc.cpp: msgrcv failed");
+            }
+            return ret;
+        }
+        if (valid_msg(msg, ret)) {
+            return ret;
+        }
+        std::cerr << "ipc.cpp: Rejected frame with unknown wire format (" << ret << " bytes, magic " << std::hex << msg.magic << std::dec << ", version " << (int)msg.version << ")" << std::endl;
+    }
+}
+
+// Same as receive_msg but gives up after timeoutMs, returning -1 with errno EAGAIN. System V queues can't wait with
+// a timeout, so those are polled every IPC_POLL_MS.
+int receive_msg_for(int msgid, msg_request& msg, int timeoutMs, long mtype) {
+    if (ipc_transport == TRANSPORT_INPROC && msgid == requestQueueId) {
+        std::unique_lock<std::mutex> lock(inprocMutex);
+        if (!inprocReady.wait_for(lock, std::chrono::milliseconds(timeoutMs), [] { return !inprocRequests.empty(); })) {
+            errno = EAGAIN;
+            return -1;
+        }
+        msg = inprocRequests.front();
+        inprocRequests.pop_front();
+        return sizeof(msg_request) - sizeof(long);
+    }
+    if (ipc_transport == TRANSPORT_SHM) {
+        bool popped;
+        if (msgid == requestQueueId) {
+            popped = channels->requests.popFor(msg, timeoutMs);
+        } else {
+            ResponseRing* ring = response_ring(mtype);
+            if (!ring) {
+                std::cerr << "ipc.cpp: No response ring for mtype " << mtype << std::endl;
+                return -1;
+            }
+            popped = ring->popFor(msg, timeoutMs);
+        }
+        if (!popped) {
+            errno = EAGAIN;
+            return -1;
+        }
+        return sizeof(msg_request) - sizeof(long);
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (true) {
+        int ret = try_receive_msg(msgid, msg, mtype);
+        if (ret != -1 || errno != ENOMSG) {
+            return ret;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            errno = EAGAIN;
+            return -1;
+        }
+        usleep(IPC_POLL_MS * 1000);
+    }
+}
+
+// Blocks for one message, then takes whatever else is already waiting without blocking, up to maxBatch in total.
+// With timeoutMs of 0 or more it waits at most that long for the first one and returns 0 if none came.
+// Returns the number of messages in batch, or -1 if the first receive failed.
+int receive_batch(int msgid, vector<msg_request>& batch, size_t maxBatch, long mtype, int timeoutMs) {
+    batch.clear();
+    msg_request msg;
+    if (timeoutMs >= 0) {
+        if (receive_msg_for(msgid, msg, timeoutMs, mtype) == -1) {
+            return errno == EAGAIN ? 0 : -1;
+        }
+    } else if (receive_msg(msgid, msg, mtype) == -1) {
+        return -1;
+    }
+    batch.push_back(msg);
+    while (batch.size() < maxBatch && try_receive_msg(msgid, msg, mtype) != -1) {
+        batch.push_back(msg);
+    }
+    return batch.size();
+}
+
+// Requests waiting in the request queue, or -1 if it can't be read. Only the System V queue costs a syscall.
+long queue_depth(int msgid) {
+    if (ipc_transport == TRANSPORT_INPROC && msgid == requestQueueId) {
+        std::lock_guard<std::mutex> lock(inprocMutex);
+        return inprocRequests.size();
+    }
+    if (ipc_transport == TRANSPORT_SHM) {
+        return msgid == requestQueueId && channels ? (long)channels->requests.size() : -1;
+    }
+    struct msqid_ds stats;
+    if (msgctl(msgid, IPC_STAT, &stats) == -1) {
+        return -1;
+    }
+    return stats.msg_qnum;
+}
+
+// Sets where the key files for the next ipc_setup are made
+void ipc_set_key_prefix(const std::string& prefix) {
+    ipc_key_prefix = prefix;
+}
+
+// Name of an opcode for console output
+const char* opcode_name(uint8_t opcode) {
+    switch (opcode) {
+        case OP_ACQUIRE: return "ACQUIRE";
+        case OP_RELEASE: return "RELEASE";
+        case OP_COMPLETE: return "COMPLETE";
+        case OP_GRANT: return "GRANT";
+        case OP_WAIT: return "WAIT";
+        case OP_DENY: return "DENY";
+        case OP_PREEMPT: return "PREEMPT";
+        default: return "UNKNOWN";
     }
-    return ret;
 }
 
 int clear_resources() {
     // Clear shared memory resources
-    shmid = shmget(key_mem, SHARED_MEMORY_SIZE, IPC_RMID);
+    if (channels) {
+        shmdt(channels);
+        channels = nullptr;
+    }
+    ipc_transport = TRANSPORT_MSGQ;
 
-    if (shmid == -1) {
-        perror ("shmget (Remove)");
+    if (shmctl(shmid, IPC_RMID, nullptr) == -1) {
+        perror ("shmctl (Remove)");
         return -1;
     }
+    shmid = -1;
 
     // Clear message queue resources
-    requestQueueId = msgctl(key_req, IPC_RMID, nullptr);
-    responseQueueId = msgctl(key_res, IPC_RMID, nullptr);
-
-    if (requestQueueId == -1) {
+    if (msgctl(requestQueueId, IPC_RMID, nullptr) == -1) {
         perror("msgctl (Request removal)");
         return -1;
     }
-    
-    if (responseQueueId == -1) {
+    requestQueueId = -1;
+
+    if (msgctl(responseQueueId, IPC_RMID, nullptr) == -1) {
         perror("msgctl (Response removal)");
         return -1;
     }
-    
+    responseQueueId = -1;
+
+    // Key files are only needed while the queues exist, a runner makes a new set for every scenario
+    if (ipc_key_prefix != IPC_KEY_PREFIX) {
+        remove((ipc_key_prefix + "_shm").c_str());
+        remove((ipc_key_prefix + "_req").c_str());
+        remove((ipc_key_prefix + "_res").c_str());
+    }
+
     return 0;
 }
@@ -7,6 +7,7 @@
 #include <sys/ipc.h>
 #include <string>
 #include <string.h>
+#include <stdint.h>
 #include <fcntl.h>
 #include <sys/shm.h>
 #include <sys/stat.h>
@@ -14,30 +15,92 @@
 #include <sys/msg.h>
 #include <iostream>
 #include <unordered_map>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 #include "parsing.hpp"
+#include "shm_ring.hpp"
 
-#define shm_key_path "/tmp/ipc_shm"
-#define mq_request_key_path "/tmp/ipc_req"
-#define mq_response_key_path "/tmp/ipc_res"
+// Key files are <prefix>_shm, <prefix>_req and <prefix>_res. Give each concurrent simulation its own prefix so they
+// don't share queues.
+#define IPC_KEY_PREFIX "/tmp/ipc"
 #define SHARED_MEMORY_SIZE sizeof(int)
 #define MSG_TYPE_DEFAULT 1
+#define MSG_TYPE_TRAIN_BASE 2 // Response mtypes for trains start here, one per train
+#define MAX_REQUEST_BATCH 256 // Most requests the server takes off the queue before handling them
+#define IPC_POLL_MS 1 // How often a timed receive checks a System V queue
+
+// Unique response mtype for a train from its id, so msgrcv only delivers that train's replies
+#define TRAIN_REPLY_TYPE(train_id) (MSG_TYPE_TRAIN_BASE + (long)(train_id))
 
 using namespace std;
 
+// Wire format. Every frame starts with MSG_MAGIC and MSG_VERSION so builds with a different layout reject each
+// other's frames instead of misreading them. Bump MSG_VERSION whenever msg_request changes.
+#define MSG_MAGIC 0xA7C5 // Not printable, so it can never match the start of an old text command like "ACQUIRE"
+#define MSG_VERSION 2
+
+enum msg_opcode : uint8_t {
+    OP_NONE = 0,
+    // Train -> server
+    OP_ACQUIRE = 1,
+    OP_RELEASE = 2,
+    OP_COMPLETE = 3,
+    // Server -> train
+    OP_GRANT = 4,
+    OP_WAIT = 5,
+    OP_DENY = 6,
+    OP_PREEMPT = 7, // Deadlock recovery took an intersection back and dropped the train's queued ACQUIRE (echoed seq)
+};
+
+// Trains and intersections are sent as their parsed ids, names are only looked up again for logging
 struct msg_request {
     long mtype;
-    char command[10];
-    char train_name[20];
-    char intersection[50];
+    uint16_t magic; // Filled in by send_msg
+    uint8_t version; // Filled in by send_msg
+    uint8_t opcode; // msg_opcode
+    uint32_t seq; // Per-train request number, echoed back in the response to that request
+    int32_t train_id; // Also tells the server which mtype to reply on
+    int32_t intersection_id;
+};
+
+static_assert(sizeof(msg_request) <= 64, "msg_request should fit in one cache line");
+
+// Transport behind send_msg/receive_msg. The message queues are always created, with TRANSPORT_SHM the frames go
+// through rings in the shared memory segment instead. TRANSPORT_INPROC only carries requests, responses to thread
+// trains are handed straight to the pool through dispatch's responseSink. Picked at runtime with IPC_TRANSPORT=shm or IPC_TRANSPORT=msgq.
+enum IpcTransport {
+    TRANSPORT_MSGQ,
+    TRANSPORT_SHM,
+    TRANSPORT_INPROC, // Trains are threads in the server process (train_pool.cpp), requests go through a locked deque
+};
+
+#define SHM_REQUEST_RING_SIZE 1024 // Every train sends into this one
+#define SHM_RESPONSE_RING_SIZE 64 // One per train, a train has at most a couple of responses outstanding
+
+typedef MpscRing<msg_request, SHM_REQUEST_RING_SIZE> RequestRing;
+typedef SpscRing<msg_request, SHM_RESPONSE_RING_SIZE> ResponseRing;
+
+// Layout of the shared memory segment in TRANSPORT_SHM, followed by numTrains ResponseRings
+struct ShmChannels {
+    uint32_t numTrains;
+    RequestRing requests;
 };
 
 // IPC request + response id's
 extern int requestQueueId;
 extern int responseQueueId;
+extern IpcTransport ipc_transport;
+extern std::string ipc_key_prefix;
 
 extern msg_request msg;
 
-int ipc_setup();
+IpcTransport ipc_transport_from_env();
+const char* transport_name(IpcTransport transport);
+size_t shm_channels_size(int numTrains);
+
+int ipc_setup(int numTrains = 0, IpcTransport transport = ipc_transport_from_env());
 /*
 class ResourceAllocationGraph {
     private:
@@ -51,8 +114,16 @@ class ResourceAllocationGraph {
         void printGraph();
 };
 */
-int send_msg(int msgid,const msg_request& msg);
+int send_msg(int msgid, const msg_request& msg);
 int receive_msg(int msgid, msg_request& msg, long mtype = MSG_TYPE_DEFAULT);
+int try_receive_msg(int msgid, msg_request& msg, long mtype = MSG_TYPE_DEFAULT);
+int receive_msg_for(int msgid, msg_request& msg, int timeoutMs, long mtype = MSG_TYPE_DEFAULT);
+int receive_batch(int msgid, vector<msg_request>& batch, size_t maxBatch, long mtype = MSG_TYPE_DEFAULT, int timeoutMs = -1);
+long queue_depth(int msgid);
+bool valid_msg(const msg_request& msg, size_t received);
+const char* opcode_name(uint8_t opcode);
+
+void ipc_set_key_prefix(const std::string& prefix);
 
 int clear_resources();
 
@@ -6,13 +6,28 @@ Date: 4/12/2025
 
 Description: Reads requests and responses sent between server and trains to write to a simulation.log file.
              Keeps track of simulated time and deadlock resolution steps.
+             In async mode (LOG_MODE=async) a log call only copies its arguments into a fixed-size record on a
+             lock-free ring, and a background thread formats the records and writes them in batches, so the server
+             never waits on the file between receiving a request and sending the GRANT.
+             In binary mode (LOG_MODE=binary) events are appended to simulation.bin as fixed-size records holding
+             ids instead of names, and logrender turns that back into the same text later.
 */
 
 #include "logging.hpp"
+#include "shm_ring.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <thread>
 
 using namespace std;
 
-std::ofstream loggingFile("simulation.log");
+std::ofstream loggingFile; // Opened on the first entry, so tools that only link this file (logrender) don't truncate it
 // ^ Wasn't sure where to put the loggingFile.close();
 // ^ May need to move std::ofstream loggingFile("logging.txt"); to a different file
 
@@ -22,18 +37,379 @@ std::ofstream loggingFile("simulation.log");
 
 // TODO: rework each to take sim_time and convert to HH:MM:SS] timestamp\
 
-// Destructor: closes file
+typedef SpscRing<LogRecord, LOG_RING_SIZE> LogRing;
+
+// Async mode state. The server thread is the only producer and the writer thread the only consumer.
+static std::unique_ptr<LogRing> logRing;
+static std::thread writerThread;
+static std::mutex writerMutex; // Only guards the writer's sleep, never taken by a log call
+static std::condition_variable writerCv;
+static std::atomic<bool> asyncRunning(false);
+static std::atomic<bool> asyncStop(false);
+static std::chrono::milliseconds flushInterval(LOG_FLUSH_INTERVAL_MS);
+
+// Binary mode state
+static std::ofstream binaryFile;
+static std::vector<char> binaryBuffer;
+static bool binaryRunning = false;
+
+// Names for the calls that take ids
+static std::vector<std::string> trainNameTable;
+static std::vector<std::string> intersectionNameTable;
+
+static std::ofstream& textFile() {
+    if (!loggingFile.is_open()) {
+        loggingFile.open("simulation.log");
+    }
+    return loggingFile;
+}
+
+static const std::string& nameOf(const std::vector<std::string>& table, int id) {
+    static const std::string unknown = "?";
+    if (id < 0 || (size_t)id >= table.size()) {
+        return unknown;
+    }
+    return table[id];
+}
+
+// Destructor: the log file is shared by every writeLog, so it stays open until the program exits
 writeLog::~writeLog() {
-    if (loggingFile.is_open()) {
-        loggingFile.close();
+}
+
+// Builds the text for one log entry. Every log function goes through here, either straight away in sync mode or
+// later on the writer thread in async mode, so both modes produce the same file.
+std::string writeLog::formatEntry(uint8_t kind, int sim_time, const std::string& a, const std::string& b, const std::string& c) {
+    std::ostringstream entry;
+    std::string timestamp = getCurrentTime(sim_time);
+    switch (kind) {
+    case LOG_MESSAGE:
+        entry << "[" << timestamp << "] " << a << ": " << b << "\n";
+        break;
+    case LOG_TRAIN_REQUEST:
+        entry << "[" << timestamp << "] " << a << ": Sent ACQUIRE request for " << b << "." << "\n";
+        break;
+    case LOG_GRANT:
+        entry << "[" << timestamp << "] SERVER: GRANTED " << b << " to " << a;
+        if (!c.empty()) {
+            entry << " " << c;
+        }
+        entry << "\n\n";
+        break;
+    case LOG_LOCK:
+        entry << "[" << timestamp << "] SERVER: " << b << " is locked. " << a << " added to wait queue." << "\n\n";
+        break;
+    case LOG_INTERSECTION_FULL:
+        entry << "[" << timestamp << "] SERVER: Intersection" << b << " is full. Train" << a << " added to wait queue." << "\n\n";
+        break;
+    case LOG_DEADLOCK_DETECTED:
+        entry << "[" << timestamp << "] SERVER: Deadlock detected! Cycle: " << a << "." << "\n";
+        break;
+    case LOG_RELEASE:
+        entry << "[" << timestamp << "] " << a << ": Released " << b << "." << "\n\n";
+        break;
+    case LOG_PREEMPTION:
+        entry << "[" << timestamp << "] SERVER: Preempting Intersection" << b << " from Train" << a << "." << "\n";
+        entry << "[" << timestamp << "] SERVER: Train" << a << " released Intersection" << b << " forcibly." << "\n";
+        break;
+    case LOG_GRANT_AFTER_PREEMPTION:
+        entry << "[" << timestamp << "] SERVER: GRANTED Intersection" << b << " to Train" << a << "." << "\n";
+        break;
+    case LOG_PROCEEDING:
+        entry << "[" << timestamp << "] TRAIN" << a << ": Acquired Intersection" << b << ". Proceeding..." << "\n";
+        break;
+    case LOG_SIMULATION_COMPLETE:
+        entry << "[" << timestamp << "] SIMULATION COMPLETE. All trains reached destinations." << "\n";
+        break;
+    }
+    return entry.str();
+}
+
+// Queues one record, waking the writer early if the ring is getting full. A full ring means the writer is behind,
+// so the server has to wait for it rather than drop log lines.
+static void pushRecord(const LogRecord& record) {
+    while (!logRing->tryPush(record)) {
+        writerCv.notify_one();
+        std::this_thread::yield();
+    }
+    if (logRing->size() >= LOG_RING_SIZE / 2) {
+        writerCv.notify_one();
+    }
+}
+
+// Copies the arguments into records back to back, spilling into LOG_CONTINUATION records when they don't fit
+static void queueEntry(uint8_t kind, int sim_time, const std::string& a, const std::string& b, const std::string& c) {
+    LogRecord record;
+    record.kind = kind;
+    record.sim_time = sim_time;
+    record.length = 0;
+    for (const std::string* field : {&a, &b, &c}) {
+        const char* text = field->c_str();
+        size_t remaining = field->size() + 1; // include the '\0'
+        while (remaining > 0) {
+            size_t chunk = std::min(remaining, (size_t)LOG_RECORD_BYTES - record.length);
+            memcpy(record.fields + record.length, text, chunk);
+            record.length += chunk;
+            text += chunk;
+            remaining -= chunk;
+            if (record.length == LOG_RECORD_BYTES && (remaining > 0 || field != &c)) {
+                record.continued = 1;
+                pushRecord(record);
+                record.kind = LOG_CONTINUATION;
+                record.length = 0;
+            }
+        }
+    }
+    record.continued = 0;
+    pushRecord(record);
+}
+
+static void flushBinary() {
+    binaryFile.write(binaryBuffer.data(), binaryBuffer.size());
+    binaryFile.flush();
+    binaryBuffer.clear();
+}
+
+// Binary mode: a fixed-size append, the file is only written once the buffer fills up
+static void appendEvent(uint8_t kind, int sim_time, int trainId, int intersectionId, int value, const std::string& text = "") {
+    LogEvent event = {};
+    event.kind = kind;
+    event.sim_time = sim_time;
+    event.train_id = trainId;
+    event.intersection_id = intersectionId;
+    event.value = value;
+    size_t offset = binaryBuffer.size();
+    binaryBuffer.resize(offset + sizeof(event) + text.size());
+    memcpy(binaryBuffer.data() + offset, &event, sizeof(event));
+    memcpy(binaryBuffer.data() + offset + sizeof(event), text.data(), text.size());
+    if (binaryBuffer.size() >= LOG_BINARY_BUFFER_BYTES) {
+        flushBinary();
+    }
+}
+
+// Every log function that takes strings ends up here
+static void writeEntry(uint8_t kind, int sim_time, const std::string& a = "", const std::string& b = "", const std::string& c = "") {
+    if (binaryRunning) {
+        std::string text = writeLog::formatEntry(kind, sim_time, a, b, c);
+        appendEvent(LOG_TEXT, sim_time, -1, -1, text.size(), text);
+        return;
+    }
+    if (asyncRunning.load(std::memory_order_relaxed)) {
+        queueEntry(kind, sim_time, a, b, c);
+        return;
+    }
+    textFile() << writeLog::formatEntry(kind, sim_time, a, b, c);
+    loggingFile.flush();
+}
+
+// Every log function that takes ids ends up here. Only binary mode keeps the ids, the others look the names up.
+static void writeEvent(uint8_t kind, int sim_time, int trainId, int intersectionId, int value = -1) {
+    if (binaryRunning) {
+        appendEvent(kind, sim_time, trainId, intersectionId, value);
+        return;
+    }
+    writeEntry(kind, sim_time, nameOf(trainNameTable, trainId), nameOf(intersectionNameTable, intersectionId), value < 0 ? "" : std::to_string(value));
+}
+
+// Background writer. Wakes every flush interval (or early when the ring is half full), formats everything queued
+// into one buffer and writes it with a single flush. Whatever is still queued when asked to stop is written first.
+static void writerLoop() {
+    LogRecord record;
+    std::string batch;
+    std::string fields; // Arguments of the entry being put back together from continuation records
+    uint8_t kind = LOG_MESSAGE;
+    int sim_time = 0;
+
+    while (true) {
+        bool stopping = asyncStop.load(std::memory_order_acquire);
+
+        while (logRing->tryPop(record)) {
+            if (record.kind != LOG_CONTINUATION) {
+                kind = record.kind;
+                sim_time = record.sim_time;
+                fields.clear();
+            }
+            fields.append(record.fields, record.length);
+            if (record.continued) {
+                continue;
+            }
+
+            // Split the arguments back out at their '\0's
+            std::string args[3];
+            size_t start = 0;
+            for (int i = 0; i < 3 && start < fields.size(); ++i) {
+                size_t end = fields.find('\0', start);
+                args[i] = fields.substr(start, end - start);
+                start = end + 1;
+            }
+            batch += writeLog::formatEntry(kind, sim_time, args[0], args[1], args[2]);
+        }
+
+        if (!batch.empty()) {
+            textFile().write(batch.data(), batch.size());
+            loggingFile.flush();
+            batch.clear();
+        }
+        if (stopping) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(writerMutex);
+        writerCv.wait_for(lock, flushInterval, [] {
+            return asyncStop.load(std::memory_order_acquire) || logRing->size() >= LOG_RING_SIZE / 2;
+        });
     }
 }
 
+//==========================================================================================
+// ASYNC MODE
+
+    // Starts the writer thread. Call it after forking the trains, a forked child doesn't get the thread.
+    void writeLog::startAsync(int flushIntervalMs) {
+        if (asyncRunning.load()) {
+            return;
+        }
+        textFile().flush();
+        if (!logRing) {
+            logRing.reset(new LogRing());
+        }
+        logRing->init();
+        flushInterval = std::chrono::milliseconds(flushIntervalMs);
+        asyncStop.store(false);
+        writerThread = std::thread(writerLoop);
+        asyncRunning.store(true);
+    }
+
+    // Writes out everything still queued, stops the writer thread and goes back to writing each entry directly
+    void writeLog::stopAsync() {
+        if (!asyncRunning.load()) {
+            return;
+        }
+        asyncRunning.store(false);
+        {
+            std::lock_guard<std::mutex> lock(writerMutex);
+            asyncStop.store(true, std::memory_order_release);
+        }
+        writerCv.notify_one();
+        writerThread.join();
+    }
+
+    bool writeLog::isAsync() {
+        return asyncRunning.load();
+    }
+
+    // LOG_MODE=async turns on async mode, LOG_FLUSH_MS sets its flush interval. LOG_MODE=binary turns on binary mode.
+    void writeLog::configureFromEnv() {
+        const char* mode = getenv("LOG_MODE");
+        if (mode && strcmp(mode, "binary") == 0) {
+            startBinary();
+            return;
+        }
+        if (!mode || strcmp(mode, "async") != 0) {
+            return;
+        }
+        const char* interval = getenv("LOG_FLUSH_MS");
+        startAsync(interval ? atoi(interval) : LOG_FLUSH_INTERVAL_MS);
+    }
+
+//==========================================================================================
+// BINARY MODE
+
+    void writeLog::setNames(const std::vector<std::string>& trainNames, const std::vector<std::string>& intersectionNames) {
+        trainNameTable = trainNames;
+        intersectionNameTable = intersectionNames;
+    }
+
+    static void writeNames(std::ostream& out, const std::vector<std::string>& names) {
+        uint32_t count = names.size();
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const std::string& name : names) {
+            uint32_t length = name.size();
+            out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+            out.write(name.data(), length);
+        }
+    }
+
+    static bool readNames(std::istream& in, std::vector<std::string>& names) {
+        uint32_t count;
+        if (!in.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+            return false;
+        }
+        names.clear();
+        for (uint32_t i = 0; i < count; ++i) {
+            uint32_t length;
+            if (!in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+                return false;
+            }
+            std::string name(length, '\0');
+            if (!in.read(&name[0], length)) {
+                return false;
+            }
+            names.push_back(name);
+        }
+        return true;
+    }
+
+    // Opens the binary log and writes the header with the current name table, so call setNames first
+    void writeLog::startBinary(const std::string& path) {
+        if (binaryRunning) {
+            return;
+        }
+        stopAsync();
+        binaryFile.open(path, std::ios::binary | std::ios::trunc);
+        uint32_t header[2] = {LOG_BINARY_MAGIC, LOG_BINARY_VERSION};
+        binaryFile.write(reinterpret_cast<const char*>(header), sizeof(header));
+        writeNames(binaryFile, trainNameTable);
+        writeNames(binaryFile, intersectionNameTable);
+        binaryBuffer.reserve(LOG_BINARY_BUFFER_BYTES + sizeof(LogEvent) + LOG_RECORD_BYTES);
+        binaryRunning = true;
+    }
+
+    void writeLog::stopBinary() {
+        if (!binaryRunning) {
+            return;
+        }
+        flushBinary();
+        binaryFile.close();
+        binaryRunning = false;
+    }
+
+    bool writeLog::isBinary() {
+        return binaryRunning;
+    }
+
+    // Turns a binary log back into the text simulation.log would have had. Returns false if the file isn't a
+    // binary log or is cut off part way through an event.
+    bool writeLog::renderBinaryLog(std::istream& in, std::ostream& out) {
+        uint32_t header[2];
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != LOG_BINARY_MAGIC || header[1] != LOG_BINARY_VERSION) {
+            return false;
+        }
+        std::vector<std::string> trainNames, intersectionNames;
+        if (!readNames(in, trainNames) || !readNames(in, intersectionNames)) {
+            return false;
+        }
+
+        LogEvent event;
+        std::string text;
+        while (in.read(reinterpret_cast<char*>(&event), sizeof(event))) {
+            if (event.kind == LOG_TEXT) {
+                text.resize(event.value);
+                if (!in.read(&text[0], event.value)) {
+                    return false;
+                }
+                out << text;
+                continue;
+            }
+            out << formatEntry(event.kind, event.sim_time, nameOf(trainNames, event.train_id), nameOf(intersectionNames, event.intersection_id),
+                event.value < 0 ? "" : std::to_string(event.value));
+        }
+        return in.gcount() == 0;
+    }
+
 //==========================================================================================
 // INITIAL LOG
     void writeLog::log(const std::string& source, const std::string& message, int sim_time) {
-        std::string timestamp = getCurrentTime(sim_time);
-        loggingFile << "[" << timestamp << "] " << source << ": " << message << std::endl;
+        writeEntry(LOG_MESSAGE, sim_time, source, message);
     }
 
 //==========================================================================================
@@ -41,8 +417,7 @@ writeLog::~writeLog() {
 
     // TRAIN AND INTERSECTION REQUEST
     void writeLog::logTrainRequest(const std::string& trainLetter, const std::string& intersectionLetter, int sim_time) {
-        std::string timestamp = getCurrentTime(sim_time);
-        loggingFile << "[" << timestamp << "] " << trainLetter << ": Sent ACQUIRE request for " << intersectionLetter << "." << std::endl;
+        writeEntry(LOG_TRAIN_REQUEST, sim_time, trainLetter, intersectionLetter);
     }
 
 //==========================================================================================
@@ -50,21 +425,13 @@ writeLog::~writeLog() {
     //GRANT INTERSECTION
     //NOTE: ADDITIONAL MESSAGE IS FOR IF WE WANT TO ADD ANY ADDITIONAL DETAILS, SUCH AS A SEMAPHORE COUNT
     void writeLog::logGrant(const std::string& trainLetter, const std::string& intersectionLetter, const std::string& semaphore, int sim_time) {
-        std::string timestamp = getCurrentTime(sim_time);
-        loggingFile << "[" << timestamp << "] SERVER: GRANTED " << intersectionLetter << " to " << trainLetter;
-
-        if (!semaphore.empty()) {
-            loggingFile << " " << semaphore;
-        }
-
-        loggingFile << std::endl << std::endl;
+        writeEntry(LOG_GRANT, sim_time, trainLetter, intersectionLetter, semaphore);
     }
 
 //==========================================================================================
     //ADD TO WAIT QUEUE
     void writeLog::logLock(const std::string& trainLetter, const std::string& intersectionLetter, int sim_time) {
-        std::string timestamp = getCurrentTime(sim_time);
-        loggingFile << "[" << timestamp << "] SERVER: " << intersectionLetter << " is locked. " << trainLetter << " added to wait queue." << std::endl << std::endl;
+        writeEntry(LOG_LOCK, sim_time, trainLetter, intersectionLetter);
     }
 
 
@@ -72,8 +439,7 @@ writeLog::~writeLog() {
 
 	// INTERSECTION FULL LOG AKA other ADD TO WAIT QUEUE
 	void writeLog::logIntersectionFull(const std::string& trainLetter, const std::string& intersectionLetter, int sim_time) {
-    	std::string timestamp = getCurrentTime(sim_time);
-    	loggingFile << "[" << timestamp << "] SERVER: Intersection" << intersectionLetter << " is full. Train" << trainLetter << " added to wait queue." << std::endl << std::endl;
+    	writeEntry(LOG_INTERSECTION_FULL, sim_time, trainLetter, intersectionLetter);
 	}
 
 //==========================================================================================
@@ -81,8 +447,7 @@ writeLog::~writeLog() {
     // DEADLOCK DETECTION LOG
     // NOTE: cycle is for what trains are at a deadlock. cycle Example: "Train1 ↔ Train3". This could also be changed to take both trains instead of a "cycle".
 	void writeLog::logDeadlockDetected(const std::string& cycle, int sim_time) {
-    	std::string timestamp = getCurrentTime(sim_time);
-    	loggingFile << "[" << timestamp << "] SERVER: Deadlock detected! Cycle: " << cycle << "." << std::endl;
+    	writeEntry(LOG_DEADLOCK_DETECTED, sim_time, cycle);
 	}
 
 
@@ -90,17 +455,14 @@ writeLog::~writeLog() {
 
 	// RELEASE INTERSECTION
 	void writeLog::logRelease(const std::string& trainLetter, const std::string& intersectionLetter, int sim_time) {
-    	std::string timestamp = getCurrentTime(sim_time);
-    	loggingFile << "[" << timestamp << "] " << trainLetter << ": Released " << intersectionLetter << "." << std::endl << std::endl;
+    	writeEntry(LOG_RELEASE, sim_time, trainLetter, intersectionLetter);
 	}
 
 //==========================================================================================
 
 	// DEADLOCK RESOLUTION LOG (PREEMPTION) AKA the other release
 	void writeLog::logPreemption(const std::string& trainLetter, const std::string& intersectionLetter, int sim_time) {
-    	std::string timestamp = getCurrentTime(sim_time);
-    	loggingFile << "[" << timestamp << "] SERVER: Preempting Intersection" << intersectionLetter << " from Train" << trainLetter << "." << std::endl;
-    	loggingFile << "[" << timestamp << "] SERVER: Train" << trainLetter << " released Intersection" << intersectionLetter << " forcibly." << std::endl;
+    	writeEntry(LOG_PREEMPTION, sim_time, trainLetter, intersectionLetter);
 	}
 
 
@@ -108,8 +470,7 @@ writeLog::~writeLog() {
 
 	// GRANT INTERSECTION AFTER PREEMPTION
 	void writeLog::logGrantAfterPreemption(const std::string& trainLetter, const std::string& intersectionLetter, int sim_time) {
-    	std::string timestamp = getCurrentTime(sim_time);
-    	loggingFile << "[" << timestamp << "] SERVER: GRANTED Intersection" << intersectionLetter << " to Train" << trainLetter << "." << std::endl;
+    	writeEntry(LOG_GRANT_AFTER_PREEMPTION, sim_time, trainLetter, intersectionLetter);
 	}
 
 
@@ -117,16 +478,52 @@ writeLog::~writeLog() {
 
 	// TRAIN PROCEEDING LOG
 	void writeLog::logProceeding(const std::string& trainLetter, const std::string& intersectionLetter, int sim_time) {
-    	std::string timestamp = getCurrentTime(sim_time);
-    	loggingFile << "[" << timestamp << "] TRAIN" << trainLetter << ": Acquired Intersection" << intersectionLetter << ". Proceeding..." << std::endl;
+    	writeEntry(LOG_PROCEEDING, sim_time, trainLetter, intersectionLetter);
 	}
 
 //==========================================================================================
 
 	// SIMULATION COMPLETE LOG
+	// Last entry of a run, so async and binary mode are shut down here and everything queued is written out
 	void writeLog::logSimulationComplete(int sim_time) {
-    	std::string timestamp = getCurrentTime(sim_time);
-    	loggingFile << "[" << timestamp << "] SIMULATION COMPLETE. All trains reached destinations." << std::endl;
+    	writeEntry(LOG_SIMULATION_COMPLETE, sim_time);
+    	stopAsync();
+    	stopBinary();
+	}
+
+//==========================================================================================
+
+	// ID OVERLOADS
+	void writeLog::logTrainRequest(int trainId, int intersectionId, int sim_time) {
+    	writeEvent(LOG_TRAIN_REQUEST, sim_time, trainId, intersectionId);
+	}
+
+	void writeLog::logGrant(int trainId, int intersectionId, int semaphoreCount, int sim_time) {
+    	writeEvent(LOG_GRANT, sim_time, trainId, intersectionId, semaphoreCount);
+	}
+
+	void writeLog::logLock(int trainId, int intersectionId, int sim_time) {
+    	writeEvent(LOG_LOCK, sim_time, trainId, intersectionId);
+	}
+
+	void writeLog::logIntersectionFull(int trainId, int intersectionId, int sim_time) {
+    	writeEvent(LOG_INTERSECTION_FULL, sim_time, trainId, intersectionId);
+	}
+
+	void writeLog::logRelease(int trainId, int intersectionId, int sim_time) {
+    	writeEvent(LOG_RELEASE, sim_time, trainId, intersectionId);
+	}
+
+	void writeLog::logPreemption(int trainId, int intersectionId, int sim_time) {
+    	writeEvent(LOG_PREEMPTION, sim_time, trainId, intersectionId);
+	}
+
+	void writeLog::logGrantAfterPreemption(int trainId, int intersectionId, int sim_time) {
+    	writeEvent(LOG_GRANT_AFTER_PREEMPTION, sim_time, trainId, intersectionId);
+	}
+
+	void writeLog::logProceeding(int trainId, int intersectionId, int sim_time) {
+    	writeEvent(LOG_PROCEEDING, sim_time, trainId, intersectionId);
 	}
 
 //==========================================================================================
@@ -138,4 +535,3 @@ writeLog::~writeLog() {
 		std::string seconds = std::to_string(sim_time % 60);
 		return hours + ":" + minutes + ":" + seconds;
 	}
-
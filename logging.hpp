@@ -7,10 +7,80 @@
 #include <iomanip>
 #include <sstream>
 #include <fstream>
+#include <stdint.h>
+#include <vector>
+
+#define LOG_FLUSH_INTERVAL_MS 50 // Default time the async writer waits between batches
+#define LOG_RING_SIZE 4096 // Records the server can queue before the writer has to catch up
+#define LOG_RECORD_BYTES 240 // String arguments of one record, longer calls spill into continuation records
+#define LOG_BINARY_PATH "simulation.bin"
+#define LOG_BINARY_MAGIC 0x474F4C54 // "TLOG"
+#define LOG_BINARY_VERSION 1
+#define LOG_BINARY_BUFFER_BYTES (64 * 1024) // Binary events are written out in chunks of about this size
+
+// Which log function a record came from, the writer thread formats it from this
+enum LogKind : uint8_t {
+    LOG_MESSAGE,
+    LOG_TRAIN_REQUEST,
+    LOG_GRANT,
+    LOG_LOCK,
+    LOG_INTERSECTION_FULL,
+    LOG_DEADLOCK_DETECTED,
+    LOG_RELEASE,
+    LOG_PREEMPTION,
+    LOG_GRANT_AFTER_PREEMPTION,
+    LOG_PROCEEDING,
+    LOG_SIMULATION_COMPLETE,
+    LOG_CONTINUATION,
+    LOG_TEXT, // Binary log only: an entry that was already formatted, value bytes of text follow the event
+};
+
+// One event in the binary log. Calls that take ids are stored as a single event and only turned into text by
+// logrender. Calls that take strings are formatted straight away and stored as a LOG_TEXT event.
+// simulation.bin layout: magic, version, train names, intersection names (each a count then length prefixed
+// strings), then events until the end of the file.
+struct LogEvent {
+    uint8_t kind;
+    uint8_t reserved[3];
+    int32_t sim_time;
+    int32_t train_id;
+    int32_t intersection_id;
+    int32_t value; // Semaphore count for LOG_GRANT (-1 for a mutex), text length for LOG_TEXT
+};
+
+// Fixed-size record queued by a log call in async mode. The string arguments are stored one after another, each
+// ending in '\0'. If they don't fit, the rest follows in LOG_CONTINUATION records and continued is set.
+struct LogRecord {
+    uint8_t kind;
+    uint8_t continued;
+    uint16_t length; // Bytes used in fields
+    int32_t sim_time;
+    char fields[LOG_RECORD_BYTES];
+};
 
 class writeLog {
 public:
     ~writeLog();
+
+    // Async mode: log calls only queue a record and a background thread formats and writes them in batches.
+    // Only one thread may log while async mode is on, which is the server thread.
+    static void startAsync(int flushIntervalMs = LOG_FLUSH_INTERVAL_MS);
+    static void stopAsync();
+    static bool isAsync();
+    static void configureFromEnv();
+
+    // Names for the calls that take ids, indexed by the parsed train and intersection ids
+    static void setNames(const std::vector<std::string>& trainNames, const std::vector<std::string>& intersectionNames);
+
+    // Binary mode: events are appended to simulation.bin and rendered to text later with logrender
+    static void startBinary(const std::string& path = LOG_BINARY_PATH);
+    static void stopBinary();
+    static bool isBinary();
+    static bool renderBinaryLog(std::istream& in, std::ostream& out);
+
+    // Builds the text of one entry, shared by every mode and logrender
+    static std::string formatEntry(uint8_t kind, int sim_time, const std::string& a = "", const std::string& b = "", const std::string& c = "");
+
     static void log(const std::string& source, const std::string& message, int sim_time = 0);
     static void logTrainRequest(const std::string& trainLetter, const std::string& intersectionLetter, int sim_time = 0);
     static void logGrant(const std::string& trainLetter, const std::string& intersectionLetter, const std::string& additionalMessage = "", int sim_time = 0);
@@ -22,6 +92,17 @@ public:
     static void logGrantAfterPreemption(const std::string& trainLetter, const std::string& intersectionLetter, int sim_time = 0);
     static void logProceeding(const std::string& trainLetter, const std::string& intersectionLetter, int sim_time = 0);
     static void logSimulationComplete(int sim_time = 0);
+
+    // Same entries by id, for the server's hot path. semaphoreCount is -1 for a mutex intersection.
+    static void logTrainRequest(int trainId, int intersectionId, int sim_time = 0);
+    static void logGrant(int trainId, int intersectionId, int semaphoreCount, int sim_time = 0);
+    static void logLock(int trainId, int intersectionId, int sim_time = 0);
+    static void logIntersectionFull(int trainId, int intersectionId, int sim_time = 0);
+    static void logRelease(int trainId, int intersectionId, int sim_time = 0);
+    static void logPreemption(int trainId, int intersectionId, int sim_time = 0);
+    static void logGrantAfterPreemption(int trainId, int intersectionId, int sim_time = 0);
+    static void logProceeding(int trainId, int intersectionId, int sim_time = 0);
+
     static std::string getCurrentTime(int sim_time = 0);
 };
 
@@ -0,0 +1,37 @@
+/*
+Group B
+Author: Caden Blust
+Email: caden.blust@okstate.edu
+Date: 10/17/2026
+
+Description: Renders a binary event log written with LOG_MODE=binary back into the text format of simulation.log.
+             Usage: ./logrender [simulation.bin] [output file]. With no output file the text goes to stdout.
+*/
+
+#include "logging.hpp"
+
+int main(int argc, char* argv[]) {
+    std::string inputPath = argc > 1 ? argv[1] : LOG_BINARY_PATH;
+
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) {
+        std::cerr << "logrender.cpp: Could not open " << inputPath << std::endl;
+        return 1;
+    }
+
+    std::ofstream outFile;
+    if (argc > 2) {
+        outFile.open(argv[2]);
+        if (!outFile) {
+            std::cerr << "logrender.cpp: Could not open " << argv[2] << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = argc > 2 ? outFile : std::cout;
+
+    if (!writeLog::renderBinaryLog(in, out)) {
+        std::cerr << "logrender.cpp: " << inputPath << " is not a binary log or is cut off" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,225 @@
+/*
+Group B
+Author: Caden Blust
+Email: caden.blust@okstate.edu
+Date: 10/17/2026
+
+Description: Server metrics for METRICS_FILE. Keeps ACQUIRE to GRANT latency and hold time histograms and grant and
+wait counts per intersection, plus deadlocks and recovery time, and dumps them with the request queue depth to a
+JSON file every METRICS_INTERVAL_MS. Recording is a clock read and a few adds, and nothing is formatted or written
+between dumps, so the server's main loop barely notices it.
+*/
+
+#include "metrics.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+void LatencyHistogram::record(double micros) {
+    int bucket = 0;
+    if (micros >= 1) {
+        bucket = std::min(METRICS_BUCKETS - 1, (int)std::log2(micros) + 1);
+    }
+    buckets[bucket]++;
+    count++;
+    sumMicros += micros;
+    maxMicros = std::max(maxMicros, micros);
+}
+
+void LatencyHistogram::add(const LatencyHistogram& other) {
+    for (int i = 0; i < METRICS_BUCKETS; ++i) {
+        buckets[i] += other.buckets[i];
+    }
+    count += other.count;
+    sumMicros += other.sumMicros;
+    maxMicros = std::max(maxMicros, other.maxMicros);
+}
+
+double LatencyHistogram::percentile(double fraction) const {
+    uint64_t target = (uint64_t)std::ceil(fraction * count);
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_BUCKETS; ++i) {
+        seen += buckets[i];
+        if (seen >= target && seen > 0) {
+            return std::min((double)(1ull << i), maxMicros);
+        }
+    }
+    return 0;
+}
+
+void ServerMetrics::reset(bool enabled, size_t numTrains, size_t numIntersections) {
+    *this = ServerMetrics();
+    this->enabled = enabled;
+    if (enabled) {
+        acquireAt.assign(numTrains, TimePoint());
+        holding.assign(numTrains, {});
+        intersections.assign(numIntersections, IntersectionMetrics());
+    }
+}
+
+void ServerMetrics::onRequest() {
+    if (enabled) {
+        requests++;
+    }
+}
+
+void ServerMetrics::onAcquire(int trainId) {
+    if (enabled) {
+        acquireAt[trainId] = std::chrono::steady_clock::now();
+    }
+}
+
+void ServerMetrics::onWait(int intersectionId) {
+    if (enabled) {
+        intersections[intersectionId].waits++;
+    }
+}
+
+void ServerMetrics::onGrant(int trainId, int intersectionId) {
+    if (!enabled) {
+        return;
+    }
+    TimePoint now = std::chrono::steady_clock::now();
+    IntersectionMetrics& intersection = intersections[intersectionId];
+    intersection.grants++;
+    intersection.acquireToGrant.record(std::chrono::duration<double, std::micro>(now - acquireAt[trainId]).count());
+    holding[trainId].push_back({intersectionId, now});
+}
+
+void ServerMetrics::onRelease(int trainId, int intersectionId) {
+    if (!enabled) {
+        return;
+    }
+    std::vector<std::pair<int, TimePoint>>& held = holding[trainId];
+    for (size_t i = 0; i < held.size(); ++i) {
+        if (held[i].first == intersectionId) {
+            double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - held[i].second).count();
+            intersections[intersectionId].hold.record(micros);
+            held[i] = held.back();
+            held.pop_back();
+            return;
+        }
+    }
+}
+
+void ServerMetrics::onDeadlock(double recoveryMicros) {
+    if (enabled) {
+        deadlocks++;
+        recovery.record(recoveryMicros);
+    }
+}
+
+// Adds the counters and histograms, the per train timing state stays with each server
+void ServerMetrics::add(const ServerMetrics& other) {
+    if (intersections.size() < other.intersections.size()) {
+        intersections.resize(other.intersections.size());
+    }
+    for (size_t i = 0; i < other.intersections.size(); ++i) {
+        intersections[i].acquireToGrant.add(other.intersections[i].acquireToGrant);
+        intersections[i].hold.add(other.intersections[i].hold);
+        intersections[i].grants += other.intersections[i].grants;
+        intersections[i].waits += other.intersections[i].waits;
+    }
+    recovery.add(other.recovery);
+    requests += other.requests;
+    deadlocks += other.deadlocks;
+}
+
+// METRICS_FILE turns metrics on and names the file, METRICS_INTERVAL_MS sets how often it is written
+bool MetricsReporter::configureFromEnv() {
+    const char* file = getenv("METRICS_FILE");
+    path = file ? file : "";
+    const char* intervalMs = getenv("METRICS_INTERVAL_MS");
+    interval = std::chrono::milliseconds(intervalMs && atoi(intervalMs) > 0 ? atoi(intervalMs) : METRICS_INTERVAL_MS);
+    start = lastDump = std::chrono::steady_clock::now();
+    return isEnabled();
+}
+
+bool MetricsReporter::due() const {
+    return isEnabled() && std::chrono::steady_clock::now() - lastDump >= interval;
+}
+
+int MetricsReporter::msUntilDue() const {
+    if (!isEnabled()) {
+        return -1;
+    }
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(lastDump + interval - std::chrono::steady_clock::now());
+    return std::max<long>(left.count(), 0);
+}
+
+static void writeHistogram(std::ostream& out, const LatencyHistogram& histogram) {
+    out << "{\"count\": " << histogram.count
+        << ", \"mean\": " << (histogram.count ? histogram.sumMicros / histogram.count : 0)
+        << ", \"p50\": " << histogram.percentile(0.5)
+        << ", \"p99\": " << histogram.percentile(0.99)
+        << ", \"max\": " << histogram.maxMicros
+        << ", \"buckets\": [";
+    for (int i = 0; i < METRICS_BUCKETS; ++i) {
+        out << (i ? ", " : "") << histogram.buckets[i];
+    }
+    out << "]}";
+}
+
+// Writes s as a JSON string. Names are whatever the config files held, so quotes, backslashes and control
+// characters are escaped rather than breaking the file.
+static void writeString(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if ((unsigned char)c < 0x20) {
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)c << std::dec << std::setfill(' ');
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+void MetricsReporter::dump(const std::vector<const ServerMetrics*>& sources, const std::vector<std::string>& intersectionNames, int sim_time, long queueDepth) {
+    if (!isEnabled()) {
+        return;
+    }
+    lastDump = std::chrono::steady_clock::now();
+
+    ServerMetrics total;
+    for (const ServerMetrics* source : sources) {
+        total.add(*source);
+    }
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream out(tempPath);
+    if (!out) {
+        std::cerr << "metrics.cpp: Can't write " << tempPath << std::endl;
+        return;
+    }
+    out << std::fixed << std::setprecision(1);
+    out << "{\n";
+    out << "  \"uptime_s\": " << std::chrono::duration<double>(lastDump - start).count() << ",\n";
+    out << "  \"sim_time\": " << sim_time << ",\n";
+    out << "  \"requests\": " << total.requests << ",\n";
+    out << "  \"request_queue_depth\": " << queueDepth << ",\n";
+    out << "  \"deadlocks\": " << total.deadlocks << ",\n";
+    out << "  \"recovery_us\": ";
+    writeHistogram(out, total.recovery);
+    out << ",\n  \"intersections\": [";
+    for (size_t i = 0; i < total.intersections.size(); ++i) {
+        const IntersectionMetrics& intersection = total.intersections[i];
+        out << (i ? "," : "") << "\n    {\"name\": ";
+        writeString(out, i < intersectionNames.size() ? intersectionNames[i] : std::to_string(i));
+        out << ", \"grants\": " << intersection.grants << ", \"waits\": " << intersection.waits
+            << ",\n     \"acquire_to_grant_us\": ";
+        writeHistogram(out, intersection.acquireToGrant);
+        out << ",\n     \"hold_us\": ";
+        writeHistogram(out, intersection.hold);
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    out.close();
+    std::rename(tempPath.c_str(), path.c_str());
+}
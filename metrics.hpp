@@ -0,0 +1,83 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stdint.h>
+
+#define METRICS_BUCKETS 32 // Histogram bucket b counts samples under 2^b microseconds that didn't fit bucket b - 1
+#define METRICS_INTERVAL_MS 1000 // Default time between dumps, METRICS_INTERVAL_MS overrides it
+
+// Latency histogram with power of two buckets in microseconds, so recording a sample is a few instructions and
+// histograms from different threads add up exactly
+struct LatencyHistogram {
+    uint64_t buckets[METRICS_BUCKETS] = {};
+    uint64_t count = 0;
+    double sumMicros = 0;
+    double maxMicros = 0;
+
+    void record(double micros);
+    void add(const LatencyHistogram& other);
+    double percentile(double fraction) const; // Upper bound of the bucket holding it
+};
+
+struct IntersectionMetrics {
+    LatencyHistogram acquireToGrant; // From the ACQUIRE arriving to its GRANT being sent, queued or not
+    LatencyHistogram hold; // From the GRANT to the RELEASE (or preemption)
+    uint64_t grants = 0;
+    uint64_t waits = 0; // ACQUIREs that had to queue
+};
+
+// Counters and histograms for one server. The server thread updates them through the on* calls, which return
+// straight away unless metrics are enabled. A sharded server keeps one per shard and they are added up when dumped.
+class ServerMetrics {
+    private:
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    bool enabled = false;
+    std::vector<TimePoint> acquireAt; // Indexed by train id, when its outstanding ACQUIRE arrived
+    std::vector<std::vector<std::pair<int, TimePoint>>> holding; // Indexed by train id, intersections and grant times
+
+    public:
+    std::vector<IntersectionMetrics> intersections; // Indexed by intersection id
+    LatencyHistogram recovery; // Time to find a victim and hand its intersections on
+    uint64_t requests = 0;
+    uint64_t deadlocks = 0;
+
+    void reset(bool enabled, size_t numTrains, size_t numIntersections);
+    bool isEnabled() const { return enabled; }
+
+    void onRequest();
+    void onAcquire(int trainId);
+    void onWait(int intersectionId);
+    void onGrant(int trainId, int intersectionId);
+    void onRelease(int trainId, int intersectionId);
+    void onDeadlock(double recoveryMicros);
+
+    void add(const ServerMetrics& other);
+};
+
+// Writes metrics to the file named by METRICS_FILE as JSON, at most every METRICS_INTERVAL_MS while the server runs
+// and once more at the end. The file is written next to it and renamed over it, so a reader never sees half of one.
+class MetricsReporter {
+    private:
+    std::string path;
+    std::chrono::milliseconds interval{METRICS_INTERVAL_MS};
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point lastDump;
+
+    public:
+    bool configureFromEnv();
+    bool isEnabled() const { return !path.empty(); }
+
+    // Cheap to call after every batch, true once the interval is up
+    bool due() const;
+    long intervalMs() const { return interval.count(); }
+    // Milliseconds until due() turns true, rounded up, so the server can wait for requests that long and no longer.
+    // -1 with metrics off.
+    int msUntilDue() const;
+    void dump(const std::vector<const ServerMetrics*>& sources, const std::vector<std::string>& intersectionNames, int sim_time, long queueDepth);
+};
+
+#endif
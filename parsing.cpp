@@ -5,153 +5,317 @@ Email: evelyn.wilson@okstate.edu
 Date: 4/12/2025
 
 Description: This code reads the intersections and trains from their respective text files into objects.
-It also defines the basic methods
+It also defines the basic methods. Each file is memory mapped and parsed in a single pass over string_views, so
+startup stays quick with very large generated networks.
 */
 
 #include "parsing.hpp"
 
+#include <cstdlib>
+#include <climits>
+#include <iterator>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 using namespace std;
 
-// Define intersection class constructor
-Intersection::Intersection(string name, unsigned int capacity) : name(name), capacity(capacity), is_mutex(capacity==1), train_count(0) {
-    if(is_mutex){ // Create mutex
-        pthread_mutexattr_t attr;
-        pthread_mutexattr_init(&attr);
-        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
-        pthread_mutex_init(&mtx, &attr);
-    } else { // Create semaphore
-        sem_init(&semaphore, 1, capacity);
+// Define intersection class constructor. Only the configuration lives here, the server's resource graph counts who
+// holds it.
+Intersection::Intersection(string name, unsigned int capacity, int id, unsigned int crossing_ms) : id(id), name(std::move(name)), capacity(capacity), crossing_ms(crossing_ms), is_mutex(capacity==1) {
+}
+
+// Define train class constructors, a train on its own copies its route into itself
+Train::Train(string name, const vector<Intersection*>& route, int id, const vector<unsigned int>& travel_ms, unsigned int departure_ms, unsigned int priority)
+    : id(id), name(std::move(name)), departure_ms(departure_ms), priority(priority) {
+    for (Intersection* intersection : route) {
+        ownRoute.push_back(intersection->id);
+    }
+    ownTravel.assign(travel_ms.begin(), travel_ms.begin() + std::min(travel_ms.size(), route.size()));
+    ownTravel.resize(route.size(), 0); // Hops without a travel time are reached straight away
+    this->route = HopSpan(ownRoute.data(), ownRoute.size());
+    this->travel_ms = HopSpan(ownTravel.data(), ownTravel.size());
+}
+
+Train::Train(string name, HopSpan route, HopSpan travel_ms, int id, unsigned int departure_ms, unsigned int priority)
+    : id(id), name(std::move(name)), route(route), travel_ms(travel_ms), departure_ms(departure_ms), priority(priority) {
+}
+
+NetworkArena::NetworkArena() : memory(NETWORK_ARENA_BLOCK) {
+}
+
+// The objects' memory is handed back with the blocks, only what they hold on the heap needs their destructors
+NetworkArena::~NetworkArena() {
+    for (Train* train : trains) {
+        train->~Train();
+    }
+    for (Intersection* intersection : intersections) {
+        intersection->~Intersection();
     }
 }
-    
-// Acquire train, called in travel function. Returns whether it was successfully acquired.
-bool Intersection::acquire(Train* train) {
-    if(is_mutex){ // Mutex method
-        if(train_count == 0) { // If intersection is empty
-            pthread_mutex_lock(&mtx);
-            trains_in_intersection.push_back(train);
-            train_count++;
-            return true; // Train was acquired
-        } else {
-            return false; // Train was not acquired
+
+Intersection* NetworkArena::newIntersection(string name, unsigned int capacity, int id, unsigned int crossing_ms) {
+    void* slot = memory.allocate(sizeof(Intersection), alignof(Intersection));
+    intersections.push_back(new (slot) Intersection(std::move(name), capacity, id, crossing_ms));
+    return intersections.back();
+}
+
+Train* NetworkArena::newTrain(string name, const vector<uint32_t>& route, int id, const vector<uint32_t>& travel_ms, unsigned int departure_ms, unsigned int priority) {
+    uint32_t* hops = static_cast<uint32_t*>(memory.allocate(2 * route.size() * sizeof(uint32_t), alignof(uint32_t)));
+    uint32_t* travel = hops + route.size();
+    std::copy(route.begin(), route.end(), hops);
+    size_t timed = std::min(travel_ms.size(), route.size());
+    std::copy(travel_ms.begin(), travel_ms.begin() + timed, travel);
+    std::fill(travel + timed, travel + route.size(), 0); // Hops without a travel time are reached straight away
+    return newTrain(std::move(name), HopSpan(hops, route.size()), HopSpan(travel, route.size()), id, departure_ms, priority);
+}
+
+Train* NetworkArena::newTrain(string name, HopSpan route, HopSpan travel_ms, int id, unsigned int departure_ms, unsigned int priority) {
+    void* slot = memory.allocate(sizeof(Train), alignof(Train));
+    trains.push_back(new (slot) Train(std::move(name), route, travel_ms, id, departure_ms, priority));
+    return trains.back();
+}
+
+// A config file mapped read only for the length of one parse. Empty if it can't be opened, like an ifstream.
+class MappedFile {
+    const char* data = nullptr;
+    size_t length = 0;
+
+public:
+    explicit MappedFile(const string& filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return;
         }
-    } else { // Semaphore method
-        if (train_count < capacity) { // If there is room for another train
-            sem_wait(&semaphore); // Unsure about this
-            trains_in_intersection.push_back(train);
-            train_count++;
-            return true; // Train was acquired
-        } else {
-            return false; // Train was not acquired
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* memory = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (memory != MAP_FAILED) {
+                data = static_cast<const char*>(memory);
+                length = info.st_size;
+                madvise(memory, length, MADV_SEQUENTIAL);
+            }
         }
-        
+        close(fd);
     }
-}
-    
-// Release train, called by the travel function. Returns whether it was successfully released.
-bool Intersection::release(Train* train) {
-    // Find the specific train in the intersection
-    auto found_train = find(trains_in_intersection.begin(), trains_in_intersection.end(), train);
-    if(found_train != trains_in_intersection.end()) { // Unlock mutex and update semaphore for intersection
-        trains_in_intersection.erase(found_train);
-        train_count--;
-        
-        if(is_mutex){
-            pthread_mutex_unlock(&mtx);
-            return true;
-        } else {
-            sem_post(&semaphore);
-            return true;
+    ~MappedFile() {
+        if (data) {
+            munmap(const_cast<char*>(data), length);
         }
-    } else {
-        cout << "Error: Train not found";
-        return false;
     }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    string_view contents() const { return string_view(data, length); }
+};
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Takes the next line off the front of text, without its newline
+static string_view nextLine(string_view& text) {
+    size_t end = text.find('\n');
+    string_view line = text.substr(0, end);
+    text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+    return line;
 }
 
-bool Intersection::isOpen() { // Returns whether the intersection has an availability or not.
-    return is_mutex ? (train_count == 0) : (train_count < capacity);
+// Takes the next field up to separator off the front of text, or all of it if there is no separator
+static string_view nextField(string_view& text, char separator) {
+    size_t end = text.find(separator);
+    string_view field = text.substr(0, end);
+    text.remove_prefix(end == string_view::npos ? text.size() : end + 1);
+    return field;
 }
 
+// Drops the whitespace the files may have in them. Names never have any inside, so the usual case is one scan that
+// finds no control characters or spaces and returns the view into the file, anything else is copied out into scratch.
+static string_view trim(string_view field, string& scratch) {
+    bool clean = true;
+    for (char c : field) {
+        clean &= (unsigned char)c > ' ';
+    }
+    if (clean) {
+        return field;
+    }
+    scratch.clear();
+    std::copy_if(field.begin(), field.end(), std::back_inserter(scratch), [](char c) { return !isSpace(c); });
+    return scratch;
+}
 
-// Define train class constructor
-Train::Train(string name, vector<Intersection*> route): name(name), route(route) {}
+static void countError(int* errors) {
+    if (errors) {
+        (*errors)++;
+    }
+}
 
-// Trim any non-allowed characters from string
-std::string trim(const std::string& str) {
-    std::string result;
-    for (char c : str) {
-        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
-            result += c;
+// Reads an optional number field (a time in milliseconds or a priority), keeping the default if it is empty, not a
+// number or larger than an int, which is what the times and priorities end up in
+static unsigned int parseNumber(string_view field, unsigned int defaultValue, string_view line, int* errors) {
+    if (field.empty()) {
+        return defaultValue;
+    }
+    unsigned long long value = 0;
+    for (char c : field) {
+        if (c < '0' || c > '9') {
+            cerr << "parsing.cpp: ERROR: invalid number " << field << " in: " << line << endl;
+            countError(errors);
+            return defaultValue;
+        }
+        value = value * 10 + (c - '0');
+        if (value > INT_MAX) {
+            cerr << "parsing.cpp: ERROR: number out of range " << field << " in: " << line << endl;
+            countError(errors);
+            return defaultValue;
         }
     }
-    return result;
+    return value;
 }
 
 // Parse intersections.txt into objects of type Intersection
-unordered_map<string, Intersection*> parseIntersections(const string& filename){
+// The file is mapped and read in one pass over string_views, only the names are copied out.
+unordered_map<string, Intersection*> parseIntersections(const string& filename, NetworkArena& arena, int* errors){
     // Create intersections unordered map so trains can access intersections by name
     unordered_map<string, Intersection*> intersections;
-    ifstream file(filename);
-    string line;
-    
-    // Works for any number of intersections
-    while(getline(file, line)) { // While there is a next line
-        stringstream ss(line);
-        string name;
-        unsigned int capacity;
-
-        getline(ss, name, ':');
-        ss >> capacity;
-
-        name = trim(name);
-
-        // Debugging parsing, remove in submission
-        cout << "parsing.cpp: Name : " << name << " , Capacity: " << capacity << endl;
-        
-        intersections[name] = new Intersection(name, capacity);
+    MappedFile file(filename);
+    string_view text = file.contents();
+    intersections.reserve(std::count(text.begin(), text.end(), '\n') + 1);
+    string scratch;
+
+    // Works for any number of intersections, Name:Capacity with an optional crossing time, Name:Capacity:CrossingMs
+    while (!text.empty()) {
+        string_view line = nextLine(text);
+        string_view fields = line;
+        string_view name = trim(nextField(fields, ':'), scratch);
+        if (name.empty()) {
+            continue; // Blank line
+        }
+        string nameCopy(name);
+        unsigned int capacity = parseNumber(trim(nextField(fields, ':'), scratch), 0, line, errors);
+        unsigned int crossing_ms = parseNumber(trim(fields, scratch), DEFAULT_CROSSING_MS, line, errors);
+        if (capacity == 0) {
+            cerr << "parsing.cpp: ERROR: intersection needs a capacity of at least 1, skipping: " << line << endl;
+            countError(errors);
+            continue; // Nothing could ever cross it
+        }
+
+        // Names are interned into dense ids in file order, once at startup
+        int id = intersections.size();
+        auto [entry, added] = intersections.try_emplace(nameCopy, nullptr);
+        if (!added) {
+            cerr << "parsing.cpp: ERROR: duplicate intersection " << nameCopy << ", keeping the first" << endl;
+            countError(errors);
+            continue;
+        }
+        entry->second = arena.newIntersection(std::move(nameCopy), capacity, id, crossing_ms);
     }
-    
+
     return intersections;
 }
 
 // Parse trains.txt into objects of type Train
-unordered_map<string, Train*> parseTrains(const string& filename, unordered_map<string, Intersection*>& intersections){
-    ifstream file(filename);
-    string line;
+// Route tokens are looked up as views into the file through an index keyed on the intersections' own names, so a
+// train costs its name and two exactly sized arrays in the arena however long its route is.
+unordered_map<string, Train*> parseTrains(const string& filename, unordered_map<string, Intersection*>& intersections, NetworkArena& arena, int* errors){
     unordered_map<string, Train*> trains;
- 
-    while(getline(file, line)) { // While there is a next line
-        stringstream ss(line);
-        string name;
-        getline(ss, name, ':');
+    MappedFile file(filename);
+    string_view text = file.contents();
+    trains.reserve(std::count(text.begin(), text.end(), '\n') + 1);
 
-        name = trim(name);
+    unordered_map<string_view, Intersection*> byName(intersections.size());
+    for (auto& [name, intersection] : intersections) {
+        byName.emplace(intersection->name, intersection);
+    }
 
-        string intersection;
-        vector<Intersection*> route;
+    string scratch;
+    vector<uint32_t> route;
+    vector<uint32_t> travel_ms;
+    while (!text.empty()) {
+        string_view line = nextLine(text);
+        string_view fields = line;
+        string_view head = trim(nextField(fields, ':'), scratch);
+        if (head.empty()) {
+            continue; // Blank line
+        }
 
-        while(getline(ss, intersection, ',')){
-            intersection = trim(intersection);
+        // Optional departure time and priority after the name, Name@DepartureMs#Priority in either order
+        auto suffix = [head](char marker) {
+            size_t start = head.find(marker);
+            if (start == string_view::npos) {
+                return string_view();
+            }
+            size_t end = head.find_first_of("@#", start + 1);
+            return head.substr(start + 1, end == string_view::npos ? string_view::npos : end - start - 1);
+        };
+        unsigned int departure_ms = parseNumber(suffix('@'), 0, line, errors);
+        unsigned int priority = parseNumber(suffix('#'), 0, line, errors);
+        string name(head.substr(0, head.find_first_of("@#")));
+        if (name.empty()) {
+            cerr << "parsing.cpp: ERROR: train needs a name, skipping: " << line << endl;
+            countError(errors);
+            continue;
+        }
+
+        route.clear();
+        travel_ms.clear();
+        bool more = !fields.empty();
+        while (more) {
+            more = fields.find(',') != string_view::npos; // A trailing comma still has an entry after it, an empty one
+            string_view intersection = trim(nextField(fields, ','), scratch);
 
-            if(intersections.find(intersection) != intersections.end()){
-                route.push_back(intersections[intersection]);
+            // Optional travel time to reach this hop, Intersection+TravelMs
+            unsigned int travel = 0;
+            size_t plus = intersection.find('+');
+            if (plus != string_view::npos) {
+                travel = parseNumber(intersection.substr(plus + 1), 0, line, errors);
+                intersection = intersection.substr(0, plus);
+            }
+            if (intersection.empty()) {
+                cerr << "parsing.cpp: ERROR: empty route entry in: " << line << endl;
+                countError(errors);
+                continue;
+            }
+
+            auto found = byName.find(intersection);
+            if (found != byName.end()) {
+                route.push_back(found->second->id);
+                travel_ms.push_back(travel);
             } else {
-                cout <<"parsing.cpp: ERROR: intersection not found: " << intersection << endl;
-                cout << endl;
+                cerr << "parsing.cpp: ERROR: intersection not found: " << intersection << endl;
+                countError(errors);
             }
         }
-        
-        // Debugging parsing, remove in submission
-        cout << "parsing.cpp: Train: " << name << " | Route: ";
-        for (auto *intersection : route)
-        {
-            cout << intersection->name << " ";
-        }
-        cout << endl;
 
-        trains[name] = new Train(name, route);
+        int id = trains.size();
+        auto [entry, added] = trains.try_emplace(name, nullptr);
+        if (!added) {
+            cerr << "parsing.cpp: ERROR: duplicate train " << name << ", keeping the first" << endl;
+            countError(errors);
+            continue;
+        }
+        entry->second = arena.newTrain(std::move(name), route, id, travel_ms, departure_ms, priority);
     }
 
     return trains;
+}
+
+// Lays the parsed intersections out by id
+vector<Intersection*> intersectionsById(const unordered_map<string, Intersection*>& intersections) {
+    vector<Intersection*> byId(intersections.size());
+    for (const auto& [name, intersection] : intersections) {
+        byId[intersection->id] = intersection;
+    }
+    return byId;
+}
+
+// Lays the parsed trains out by id
+vector<Train*> trainsById(const unordered_map<string, Train*>& trains) {
+    vector<Train*> byId(trains.size());
+    for (const auto& [name, train] : trains) {
+        byId[train->id] = train;
+    }
+    return byId;
 }
\ No newline at end of file
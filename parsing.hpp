@@ -4,49 +4,106 @@
 #include <iostream>
 #include <sstream>
 #include <vector>
+#include <deque>
 #include <thread>
 #include <string>
+#include <string_view>
 #include <mutex>
 #include <fstream>
 #include <unordered_map>
-#include <semaphore.h>
-#include <pthread.h>
-#include <condition_variable>
 #include <algorithm>
+#include <memory_resource>
+#include <stdint.h>
 
 class Train;
 
+#define DEFAULT_CROSSING_MS 1000 // Time a train holds an intersection while crossing it, unless intersections.txt says otherwise
+#define NETWORK_ARENA_BLOCK (64 * 1024) // Size of the arena's first block, each one after is bigger
+
 class Intersection {
 public:
+    int id; // Dense id in file order, used everywhere on the server instead of the name
     std::string name;
     unsigned int capacity;
-    bool is_mutex;
-    bool lock_state;
-    unsigned int train_count;
+    unsigned int crossing_ms; // Optional third field, Name:Capacity:CrossingMs
+    bool is_mutex; // Capacity of one, logged as a mutex rather than a semaphore
+
+    std::deque<Train*> wait_queue; // Trains blocked on this intersection, granted in FIFO order on release
 
-    pthread_mutex_t mtx;
-    sem_t semaphore;
-    std::condition_variable cv;
+    Intersection(std::string name, unsigned int capacity, int id = -1, unsigned int crossing_ms = DEFAULT_CROSSING_MS);
+};
 
-    std::vector<Train*> trains_in_intersection;
+// One value per hop of a train's route, read only. A view of an array that lives in the network's arena, in a
+// compiled topology the server mapped, or in the train itself, so a train loaded from a topology points straight at
+// the file.
+class HopSpan {
+    private:
+    const uint32_t* first = nullptr;
+    size_t count = 0;
 
-    Intersection(std::string name, unsigned int capacity);
+    public:
+    HopSpan() = default;
+    HopSpan(const uint32_t* first, size_t count) : first(first), count(count) {}
 
-    bool acquire(Train* train);
-    bool release(Train* train);
-    bool isOpen();
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    uint32_t operator[](size_t hop) const { return first[hop]; }
+    const uint32_t* begin() const { return first; }
+    const uint32_t* end() const { return first + count; }
+    bool operator==(const std::vector<uint32_t>& values) const { return std::equal(begin(), end(), values.begin(), values.end()); }
 };
 
 class Train {
 public:
+    int id; // Dense id in file order, also picks the train's response mtype
     std::string name;
-    std::vector<Intersection*> route;
-    Intersection* current_location;
+    HopSpan route; // Intersection id of each hop
+    HopSpan travel_ms; // Time spent getting to each hop before requesting it, parallel to route
+    unsigned int departure_ms; // Time before the train sets off, Name@DepartureMs
+    unsigned int priority; // Name#Priority, higher is more important, used when picking a deadlock victim
 
-    Train(std::string name, std::vector<Intersection*> route);
+    // A train made on its own keeps a copy of its route. The intersections need their ids by now.
+    Train(std::string name, const std::vector<Intersection*>& route, int id = -1, const std::vector<unsigned int>& travel_ms = {}, unsigned int departure_ms = 0, unsigned int priority = 0);
+    // A train whose route and travel times are stored elsewhere and outlive it, e.g. in a topology
+    Train(std::string name, HopSpan route, HopSpan travel_ms, int id, unsigned int departure_ms, unsigned int priority);
+    Train(const Train&) = delete; // The spans may point into the train itself
+    Train& operator=(const Train&) = delete;
+
+private:
+    std::vector<uint32_t> ownRoute;
+    std::vector<uint32_t> ownTravel;
 };
 
-std::unordered_map<std::string, Intersection*> parseIntersections(const std::string& filename);
-std::unordered_map<std::string, Train*> parseTrains(const std::string& filename, std::unordered_map<std::string, Intersection*>& intersections);
+// Owns every Intersection and Train of one network along with their route arrays. They are bump allocated from a
+// few large blocks, so the network sits together in memory, and all of it goes at once when the arena does.
+// Names longer than the small string buffer and the wait queues, which come and go all run, stay on the heap and
+// are freed by the destructors the arena runs first. Trains loaded from a topology keep their routes in it instead.
+class NetworkArena {
+    private:
+    std::pmr::monotonic_buffer_resource memory;
+    std::vector<Intersection*> intersections;
+    std::vector<Train*> trains;
+
+    public:
+    NetworkArena();
+    ~NetworkArena();
+    NetworkArena(const NetworkArena&) = delete;
+    NetworkArena& operator=(const NetworkArena&) = delete;
+
+    Intersection* newIntersection(std::string name, unsigned int capacity, int id, unsigned int crossing_ms);
+    // Copies the route's intersection ids and the travel times into the arena, travel_ms is padded out with zeros
+    Train* newTrain(std::string name, const std::vector<uint32_t>& route, int id, const std::vector<uint32_t>& travel_ms, unsigned int departure_ms, unsigned int priority);
+    // Keeps the route and travel times where they are
+    Train* newTrain(std::string name, HopSpan route, HopSpan travel_ms, int id, unsigned int departure_ms, unsigned int priority);
+};
+
+// Invalid lines are reported on stderr and skipped or given defaults, errors (if given) counts them.
+// The objects belong to the arena and live until it is destroyed.
+std::unordered_map<std::string, Intersection*> parseIntersections(const std::string& filename, NetworkArena& arena, int* errors = nullptr);
+std::unordered_map<std::string, Train*> parseTrains(const std::string& filename, std::unordered_map<std::string, Intersection*>& intersections, NetworkArena& arena, int* errors = nullptr);
+
+// Id-indexed views of the parsed maps, names are only needed again when logging
+std::vector<Intersection*> intersectionsById(const std::unordered_map<std::string, Intersection*>& intersections);
+std::vector<Train*> trainsById(const std::unordered_map<std::string, Train*>& trains);
 
 #endif
@@ -0,0 +1,36 @@
+/*
+Group B
+Author: Gavin Zlatar
+Email: gavin.zlatar@okstate.edu
+Date: 10/17/2026
+
+Description: Replays a request trace recorded with TRACE_FILE against the server's dispatch at full speed and
+             prints its throughput and what it granted. Run the same trace through two builds and compare the
+             totals and the digest to see whether they behave the same.
+             Usage: ./replay trace.bin [intersections.txt] [trains.txt]. The network must be the one the trace was
+             recorded against, TOPOLOGY_FILE works as it does for the server.
+*/
+
+#include "trace.hpp"
+#include "simulation.hpp"
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: ./replay trace.bin [intersections.txt] [trains.txt]" << std::endl;
+        return 1;
+    }
+    std::string intersectionsPath = argc > 2 ? argv[2] : "intersections.txt";
+    std::string trainsPath = argc > 3 ? argv[3] : "trains.txt";
+
+    ReplayResult result;
+    if (replayTrace(argv[1], intersectionsPath, trainsPath, result) != 0) {
+        return 1;
+    }
+    std::cout << "replay.cpp: " << result.requests << " requests in " << result.batches << " batches, "
+              << result.seconds * 1000 << " ms, " << (long)result.requestsPerSecond() << " requests/s\n"
+              << "replay.cpp: trains " << result.completed << "/" << simStats.trains << " completed, grants " << simStats.grants
+              << ", deadlocks " << simStats.deadlocks << ", preemptions " << simStats.preemptions << ", deferred " << simStats.deferred
+              << ", makespan " << simStats.makespan << ", responses " << result.responses
+              << ", digest " << std::hex << result.digest << std::dec << std::endl;
+    return 0;
+}
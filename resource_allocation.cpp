@@ -13,61 +13,228 @@ using namespace std;
 
 // Populate the graph with pointers to the existing Intersection objects
 // Should be called in a for loop in server to initialize the Resource Allocation graph
+// Intersections built without an id (e.g. in tests) get the next free one
 void ResourceAllocationGraph::addIntersection(Intersection *intersection)
 {
-    // Adds an interesection to the intersection map in the graph
-    intersectionMap[intersection->name] = intersection;
+    if (intersection->id < 0)
+    {
+        intersection->id = intersections.size();
+    }
+    if ((size_t)intersection->id >= intersections.size())
+    {
+        intersections.resize(intersection->id + 1, nullptr);
+    }
+
+    // Adds an interesection to the intersection table in the graph, at its id
+    intersections[intersection->id] = intersection;
+    nameIndex[intersection->name] = intersection->id;
+
+    // Every intersection gets a row in the allocation table
+    holderCount.resize(intersections.size(), 0);
+    holderBits.resize(intersections.size() * wordsPerRow, 0);
+}
+
+// Widens every bitset row so the train id fits, doubling so a run of new trains only relays the table a few times
+void ResourceAllocationGraph::growTrains(int trainId)
+{
+    if ((size_t)trainId >= trainsById.size())
+    {
+        trainsById.resize(trainId + 1, nullptr);
+        holdings.resize(trainId + 1);
+    }
+    size_t needed = trainId / 64 + 1;
+    if (needed <= wordsPerRow)
+    {
+        return;
+    }
+
+    size_t newWords = std::max(needed, wordsPerRow * 2);
+    std::vector<uint64_t> widened(intersections.size() * newWords, 0);
+    for (size_t id = 0; id < intersections.size(); ++id)
+    {
+        std::copy(holderBits.begin() + id * wordsPerRow, holderBits.begin() + (id + 1) * wordsPerRow, widened.begin() + id * newWords);
+    }
+    holderBits.swap(widened);
+    wordsPerRow = newWords;
+}
+
+void ResourceAllocationGraph::addHolder(int intersectionId, Train *train)
+{
+    growTrains(train->id);
+    trainsById[train->id] = train;
+    holderBits[intersectionId * wordsPerRow + train->id / 64] |= uint64_t(1) << (train->id % 64);
+    holderCount[intersectionId]++;
+    holdings[train->id].push_back(intersectionId);
+}
+
+void ResourceAllocationGraph::removeHolder(int intersectionId, int trainId)
+{
+    holderBits[intersectionId * wordsPerRow + trainId / 64] &= ~(uint64_t(1) << (trainId % 64));
+    holderCount[intersectionId]--;
+
+    // A train only holds a couple of intersections at once, swap the last one into its place
+    std::vector<int> &held = holdings[trainId];
+    auto found = std::find(held.begin(), held.end(), intersectionId);
+    *found = held.back();
+    held.pop_back();
+}
+
+// Grants the intersection if it has a free unit. The holder count in the table is the only admission state, the
+// server owns it so no lock is needed. A train can't jump ahead of trains already waiting in the intersection's queue
+bool ResourceAllocationGraph::acquire(int intersectionId, Train *train)
+{
+    if (!intersections[intersectionId]->wait_queue.empty() || !isOpen(intersectionId) || holds(intersectionId, train->id))
+    {
+        return false;
+    }
+    addHolder(intersectionId, train);
+    return true;
+}
+
+// Frees the train's unit, if the train really holds the intersection
+bool ResourceAllocationGraph::release(int intersectionId, Train *train)
+{
+    if (!holds(intersectionId, train->id))
+    {
+        return false;
+    }
+    removeHolder(intersectionId, train->id);
+    return true;
+}
+
+// Adds a train to the back of the intersection's wait queue after a failed acquire
+void ResourceAllocationGraph::enqueue(int intersectionId, Train *train)
+{
+    intersections[intersectionId]->wait_queue.push_back(train);
+}
+
+// Hands the intersection to the train at the front of its wait queue if there is room.
+// Returns the train that was granted, or nullptr if nobody is waiting or the intersection is still full.
+// Call in a loop after a release, a semaphore can have room for more than one waiter.
+Train *ResourceAllocationGraph::grantNext(int intersectionId)
+{
+    Intersection *intersection = intersections[intersectionId];
+    if (intersection->wait_queue.empty() || !isOpen(intersectionId))
+    {
+        return nullptr;
+    }
+
+    Train *next = intersection->wait_queue.front();
+    intersection->wait_queue.pop_front();
+    addHolder(intersectionId, next);
+    return next;
+}
+
+// Hands the intersection to the train at the given place in its wait queue, for when the trains ahead of it can't
+// be granted yet. The caller checks there is room.
+Train *ResourceAllocationGraph::grantQueued(int intersectionId, size_t position)
+{
+    Intersection *intersection = intersections[intersectionId];
+    Train *next = intersection->wait_queue[position];
+    intersection->wait_queue.erase(intersection->wait_queue.begin() + position);
+    addHolder(intersectionId, next);
+    return next;
 }
 
-// Calls the logic to acquire a train in parsing.cpp
-// Seems redundant but it isolates it and makes it cleaner to call from server
-bool ResourceAllocationGraph::acquire(const string &intersectionName, Train *train)
+// Returns nullptr for an id that isn't in the graph, so ids coming off the message queue can be checked
+Intersection *ResourceAllocationGraph::getIntersection(int intersectionId) const
 {
-    return intersectionMap[intersectionName]->acquire(train);
+    if (intersectionId < 0 || (size_t)intersectionId >= intersections.size())
+    {
+        return nullptr;
+    }
+    return intersections[intersectionId];
 }
 
-// Calls the logic to release a train in parsing.cpp
-bool ResourceAllocationGraph::release(const string &intersectionName, Train *train)
+Intersection *ResourceAllocationGraph::getIntersection(const std::string &name) const
 {
-    return intersectionMap[intersectionName]->release(train);
+    auto found = nameIndex.find(name);
+    return found == nameIndex.end() ? nullptr : intersections[found->second];
 }
 
-Intersection* ResourceAllocationGraph::getIntersection(const std::string& name) {
-    return intersectionMap[name];
+int ResourceAllocationGraph::size() const
+{
+    return intersections.size();
 }
 
 void ResourceAllocationGraph::printGraph()
 {
-    // Goes through the key-value pairs in the map, listing out the fields (mutex vs semaphore, trains held, etc)for each intersection
-    for (const auto &pair : intersectionMap)
+    // Goes through the intersections, listing out the fields (mutex vs semaphore, trains held, etc)for each intersection
+    for (const Intersection *inter : intersections)
     {
-        const Intersection *inter = pair.second; // pair.second is the value in the key-value pair. It's accessing the actual data
+        if (!inter)
+        {
+            continue;
+        }
         cout << inter->name << " | " << (inter->is_mutex ? "Mutex" : "Semaphore")
              << " | " << inter->capacity << " | Held by: ";
-        for (const auto &train : inter->trains_in_intersection)
+        for (int trainId : holders(inter->id))
         {
-            cout << train->name << " ";
+            cout << trainsById[trainId]->name << " ";
         }
         cout << endl;
     }
 }
 
-// Outputs an unordered map of the intersection names and the trains in the intersection.
-unordered_map<string, vector<string>> ResourceAllocationGraph::getResourceGraph() const
-{ 
-    unordered_map<string, vector<string>> graph;
-    for (const auto &pair : intersectionMap)
+bool ResourceAllocationGraph::holds(int intersectionId, int trainId) const
+{
+    if (trainId < 0 || (size_t)trainId / 64 >= wordsPerRow)
     {
-        vector<string> trains;
-        for (Train *train : pair.second->trains_in_intersection)
-        {
-            trains.push_back(train->name);
-        }
-        graph[pair.first] = trains;
+        return false;
+    }
+    return holderBits[intersectionId * wordsPerRow + trainId / 64] >> (trainId % 64) & 1;
+}
+
+// The trains holding the intersection, as a view into its row of the table
+HolderView ResourceAllocationGraph::holders(int intersectionId) const
+{
+    return HolderView(holderBits.data() + intersectionId * wordsPerRow, wordsPerRow, holderCount[intersectionId]);
+}
+
+// The intersections the train holds, in no particular order
+const vector<int> &ResourceAllocationGraph::heldBy(int trainId) const
+{
+    static const vector<int> none;
+    if (trainId < 0 || (size_t)trainId >= holdings.size())
+    {
+        return none;
     }
-    return graph;
+    return holdings[trainId];
+}
+
+int ResourceAllocationGraph::freeUnits(int intersectionId) const
+{
+    return (int)intersections[intersectionId]->capacity - (int)holderCount[intersectionId];
+}
+
+// Whether the intersection has room for another train
+bool ResourceAllocationGraph::isOpen(int intersectionId) const
+{
+    return holderCount[intersectionId] < intersections[intersectionId]->capacity;
+}
+
+// The train ids in each intersection, indexed by intersection id. A view of the table, nothing is copied.
+AllocationView ResourceAllocationGraph::getResourceGraph() const
+{
+    return AllocationView(this);
 }
 
 void ResourceAllocationGraph::clear() {
-    intersectionMap.clear();
-}
\ No newline at end of file
+    intersections.clear();
+    nameIndex.clear();
+    holderCount.clear();
+    holderBits.clear();
+    wordsPerRow = 0;
+    holdings.clear();
+    trainsById.clear();
+}
+
+int HolderView::operator[](size_t index) const
+{
+    iterator it = begin();
+    for (size_t i = 0; i < index; ++i)
+    {
+        ++it;
+    }
+    return *it;
+}
@@ -8,27 +8,112 @@
 #include <string>
 #include <mutex>
 #include <fstream>
+#include <cstdint>
 #include <unordered_map>
-#include <semaphore.h>
-#include <pthread.h>
 #include <condition_variable>
 #include <algorithm>
 #include "parsing.hpp"
 
 using namespace std;
 
+// Ids of the trains holding one intersection, read straight out of its row in the allocation table without copying.
+// Goes in train id order and only stays valid until the next acquire or release.
+class HolderView {
+    private:
+    const uint64_t* words;
+    size_t numWords;
+    size_t count;
+
+    public:
+    class iterator {
+        private:
+        const uint64_t* words;
+        size_t numWords;
+        size_t word;
+        uint64_t bits; // Bits of the current word not visited yet
+
+        void skipEmpty() {
+            while (bits == 0 && word + 1 < numWords) {
+                bits = words[++word];
+            }
+            if (bits == 0) {
+                word = numWords;
+            }
+        }
+
+        public:
+        iterator(const uint64_t* words, size_t numWords, size_t word) : words(words), numWords(numWords), word(word), bits(word < numWords ? words[word] : 0) {
+            skipEmpty();
+        }
+        int operator*() const { return word * 64 + __builtin_ctzll(bits); }
+        iterator& operator++() {
+            bits &= bits - 1;
+            skipEmpty();
+            return *this;
+        }
+        bool operator==(const iterator& other) const { return word == other.word && bits == other.bits; }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+    };
+
+    HolderView(const uint64_t* words, size_t numWords, size_t count) : words(words), numWords(numWords), count(count) {}
+    iterator begin() const { return iterator(words, numWords, 0); }
+    iterator end() const { return iterator(words, numWords, numWords); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    int operator[](size_t index) const; // Walks the row, for tests and logging
+};
+
+class AllocationView;
+
+// Keeps which train holds which intersection in a structure of arrays allocation table indexed by id: a holder
+// count and a bitset row over train ids for each intersection, plus the few intersections each train holds.
+// Acquire, release and "does this train hold it" are O(1), and readers get views into the table instead of copies.
 class ResourceAllocationGraph{
     private:
-    std::unordered_map<std::string, Intersection *> intersectionMap;
+    std::vector<Intersection *> intersections; // Indexed by intersection id
+    std::unordered_map<std::string, int> nameIndex; // Only for looking names up at the edges (tests, config)
+
+    // Allocation table
+    std::vector<unsigned int> holderCount; // Indexed by intersection id
+    std::vector<uint64_t> holderBits; // wordsPerRow words per intersection id, bit t is set while train t holds it
+    size_t wordsPerRow = 0;
+    std::vector<std::vector<int>> holdings; // Indexed by train id, intersection ids it holds, only ever a few
+    std::vector<Train *> trainsById; // Trains seen so far, for printing names
+
+    void growTrains(int trainId);
+    void addHolder(int intersectionId, Train* train);
+    void removeHolder(int intersectionId, int trainId);
 
     public:
-    Intersection* getIntersection(const string& intersectionName);
+    Intersection* getIntersection(int intersectionId) const;
+    Intersection* getIntersection(const string& intersectionName) const;
+    int size() const;
     void addIntersection(Intersection* inter);
-    bool acquire(const string& intersectionName, Train* train);
-    bool release(const string& intersectionName, Train* train);
+    bool acquire(int intersectionId, Train* train);
+    bool release(int intersectionId, Train* train);
+    void enqueue(int intersectionId, Train* train);
+    Train* grantNext(int intersectionId);
+    Train* grantQueued(int intersectionId, size_t position);
     void printGraph();
-    unordered_map<string, vector<string>> getResourceGraph() const;
+
+    bool holds(int intersectionId, int trainId) const;
+    HolderView holders(int intersectionId) const;
+    const vector<int>& heldBy(int trainId) const;
+    int freeUnits(int intersectionId) const;
+    bool isOpen(int intersectionId) const;
+    AllocationView getResourceGraph() const;
     void clear();
 };
 
-#endif
\ No newline at end of file
+// The whole table as holders indexed by intersection id, for deadlock handling and tests. Reads the live table.
+class AllocationView {
+    private:
+    const ResourceAllocationGraph* graph;
+
+    public:
+    explicit AllocationView(const ResourceAllocationGraph* graph) : graph(graph) {}
+    HolderView operator[](int intersectionId) const { return graph->holders(intersectionId); }
+    size_t size() const { return graph->size(); }
+};
+
+#endif
@@ -0,0 +1,160 @@
+/*
+Group: B
+Author: Gavin Zlatar
+Email: gavin.zlatar@okstate.edu
+Date: 10/17/2026
+
+Description: Runs many scenarios in parallel for capacity planning. A scenario is a directory holding its own
+intersections.txt and trains.txt. Each scenario runs in its own process, in its own directory, with its own IPC
+keys, so its simulation.log and server output land next to its config and runs never share a queue. At most one
+scenario per core runs at a time. When they are all done a summary table is printed.
+
+Usage: ./runner [-j jobs] scenarioDir...
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "simulation.hpp"
+
+// One scenario and the process running it
+struct Scenario {
+    std::string dir;
+    pid_t pid = -1;
+    int resultPipe = -1; // Read end, the child writes its SimulationStats here
+    int status = -1; // Exit status of the child, -1 until it has finished
+    bool hasStats = false;
+    SimulationStats stats;
+};
+
+// Runs in the forked child. Never returns.
+static void runScenario(const Scenario& scenario, int resultPipe) {
+    if (chdir(scenario.dir.c_str()) == -1) {
+        perror(("runner.cpp: " + scenario.dir).c_str());
+        _exit(2);
+    }
+
+    // The server and its trains are chatty, keep their output with the scenario
+    int output = open("server_output.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output != -1) {
+        dup2(output, STDOUT_FILENO);
+        dup2(output, STDERR_FILENO);
+        close(output);
+    }
+
+    ipc_set_key_prefix("/tmp/ipc_runner_" + std::to_string(getpid()));
+    int result = runServer("intersections.txt", "trains.txt");
+    if (requestQueueId != -1) {
+        clear_resources(); // Event driven runs never set up IPC
+    }
+
+    if (result == 0) {
+        write(resultPipe, &simStats, sizeof(simStats));
+    }
+    close(resultPipe);
+    std::cout.flush();
+    _exit(result);
+}
+
+static void printSummary(const std::vector<Scenario>& scenarios) {
+    std::cout << std::left << std::setw(28) << "Scenario" << std::right
+              << std::setw(8) << "Trains" << std::setw(10) << "Makespan" << std::setw(10) << "Wall(s)"
+              << std::setw(11) << "Deadlocks" << std::setw(11) << "Preempted" << std::setw(12) << "Recovered/s" << std::setw(10) << "Deferred" << std::setw(11) << "Wait" << std::setw(10) << "Wait(s)" << "  Status\n";
+    std::cout << std::fixed << std::setprecision(2);
+    for (const Scenario& scenario : scenarios) {
+        std::cout << std::left << std::setw(28) << scenario.dir << std::right;
+        if (scenario.hasStats) {
+            const SimulationStats& stats = scenario.stats;
+            std::cout << std::setw(8) << stats.trains << std::setw(10) << stats.makespan << std::setw(10) << stats.wallSeconds
+                      << std::setw(11) << stats.deadlocks << std::setw(11) << stats.preemptions << std::setw(12);
+            if (stats.firstRecoveryAt >= 0) {
+                // Grants per sim_time tick from the first preemption to the end of the run
+                std::cout << (double)stats.grantsAfterRecovery / std::max(1, stats.makespan - stats.firstRecoveryAt);
+            } else {
+                std::cout << "-";
+            }
+            std::cout << std::setw(10) << stats.deferred << std::setw(11) << stats.waitTime << std::setw(10) << stats.waitSeconds << "  ok\n";
+        } else {
+            std::cout << std::setw(93) << "" << "  failed (exit " << scenario.status << ")\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    std::vector<Scenario> scenarios;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+            continue;
+        }
+        Scenario scenario;
+        scenario.dir = argv[i];
+        scenarios.push_back(scenario);
+    }
+    if (scenarios.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [-j jobs] scenarioDir...\n";
+        return 1;
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
+
+    std::cout << "runner.cpp: Running " << scenarios.size() << " scenarios, " << jobs << " at a time\n";
+    std::cout.flush();
+
+    size_t next = 0;
+    int running = 0;
+    while (next < scenarios.size() || running > 0) {
+        // Start scenarios until every job slot is busy
+        while (next < scenarios.size() && running < jobs) {
+            Scenario& scenario = scenarios[next++];
+            int fds[2];
+            if (pipe(fds) == -1) {
+                perror("runner.cpp: pipe");
+                return 1;
+            }
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fds[0]);
+                runScenario(scenario, fds[1]);
+            }
+            close(fds[1]);
+            if (pid < 0) {
+                perror("runner.cpp: fork");
+                close(fds[0]);
+                continue;
+            }
+            scenario.pid = pid;
+            scenario.resultPipe = fds[0];
+            running++;
+        }
+
+        // Collect whichever scenario finishes first
+        int status;
+        pid_t done = wait(&status);
+        if (done == -1) {
+            break;
+        }
+        for (Scenario& scenario : scenarios) {
+            if (scenario.pid != done) {
+                continue;
+            }
+            scenario.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+            scenario.hasStats = read(scenario.resultPipe, &scenario.stats, sizeof(scenario.stats)) == sizeof(scenario.stats);
+            close(scenario.resultPipe);
+            running--;
+            std::cout << "runner.cpp: Finished " << scenario.dir << std::endl;
+        }
+    }
+
+    printSummary(scenarios);
+    return 0;
+}
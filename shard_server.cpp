@@ -0,0 +1,354 @@
+/*
+Group: B
+Author: Gavin Zlatar
+Email: gavin.zlatar@okstate.edu
+Date: 10/17/2026
+
+Description: Sharded allocation server for SERVER_SHARDS=N. Intersections are partitioned over N worker threads by
+id and each worker applies the requests for its own intersections, the same way dispatch.cpp does for the whole
+network. A train only ever waits on one intersection, so its wait-for edges always come from one shard, and the
+coordinator can merge them into the global wait-for graph after every batch and look for cycles across shards.
+*/
+
+#include "shard_server.hpp"
+
+#include <cstdlib>
+
+// SERVER_SHARDS sets the number of shards, 1 (no sharding) by default
+int serverShardsFromEnv() {
+    const char* shards = getenv("SERVER_SHARDS");
+    int count = shards ? atoi(shards) : 1;
+    return count > 0 ? count : 1;
+}
+
+// Every shard gets the intersections with id % numShards equal to its index, at their usual ids
+ShardedServer::ShardedServer(std::vector<Train*>& trains, const std::vector<Intersection*>& intersections, int numShards)
+    : trains(trains), trainState(trains.size()), lockResponses(ipc_transport == TRANSPORT_SHM) {
+    for (int i = 0; i < numShards; ++i) {
+        shards.emplace_back(new Shard());
+    }
+    for (Intersection* inter : intersections) {
+        shardOf(inter->id).graph.addIntersection(inter);
+    }
+    for (auto& shard : shards) {
+        shard->metrics.reset(serverMetrics.isEnabled(), trains.size(), intersections.size());
+    }
+    for (auto& shard : shards) {
+        shard->worker = std::thread(&ShardedServer::workerLoop, this, std::ref(*shard));
+    }
+    std::cout << "shard_server.cpp: " << intersections.size() << " intersections split over " << numShards << " shards" << std::endl;
+}
+
+ShardedServer::~ShardedServer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    startBatch.notify_all();
+    for (auto& shard : shards) {
+        shard->worker.join();
+    }
+}
+
+int ShardedServer::size() const {
+    return shards.size();
+}
+
+// Adds each shard's metrics to the ones a dump adds up, only read between batches
+void ShardedServer::metricsSources(std::vector<const ServerMetrics*>& sources) const {
+    for (const auto& shard : shards) {
+        sources.push_back(&shard->metrics);
+    }
+}
+
+ShardedServer::Shard& ShardedServer::shardOf(int intersectionId) {
+    return *shards[intersectionId % shards.size()];
+}
+
+// Waits for the coordinator to hand out a batch, applies this shard's part of it and reports back
+void ShardedServer::workerLoop(Shard& shard) {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startBatch.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        for (const ShardRequest& request : shard.inbox) {
+            apply(shard, request);
+        }
+        shard.inbox.clear();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--running == 0) {
+            batchDone.notify_one();
+        }
+    }
+}
+
+// Starts every shard on its inbox and waits until they are all done
+void ShardedServer::runShards() {
+    std::unique_lock<std::mutex> lock(mutex);
+    running = shards.size();
+    generation++;
+    startBatch.notify_all();
+    batchDone.wait(lock, [&] { return running == 0; });
+}
+
+// Same as dispatch's sendResponse without the console trace, which would interleave between shards
+void ShardedServer::respond(uint8_t opcode, Train* train, int intersectionId, uint32_t seq) {
+    msg_request msg;
+    msg.mtype = TRAIN_REPLY_TYPE(train->id);
+    msg.opcode = opcode;
+    msg.seq = seq;
+    msg.train_id = train->id;
+    msg.intersection_id = intersectionId;
+    if (responseSink) {
+        // Sinks are written for the one server thread dispatch calls them from, every shard calls this
+        std::lock_guard<std::mutex> lock(responseMutex);
+        responseSink(msg);
+        return;
+    }
+    if (lockResponses) {
+        std::lock_guard<std::mutex> lock(responseMutex);
+        send_msg(responseQueueId, msg);
+        return;
+    }
+    send_msg(responseQueueId, msg);
+}
+
+void ShardedServer::grant(Shard& shard, Train* train, Intersection* inter, int tick) {
+    int semaphore_count = inter->is_mutex ? -1 : shard.graph.freeUnits(inter->id);
+    shard.logs.push_back({LOG_GRANT, tick, train->id, inter->id, semaphore_count});
+
+    TrainState& state = trainState[train->id];
+    respond(OP_GRANT, train, inter->id, state.pendingSeq);
+    shard.grants++;
+    shard.metrics.onGrant(train->id, inter->id);
+    if (simStats.firstRecoveryAt >= 0) {
+        shard.grantsAfterRecovery++;
+    }
+    if (state.queuedSince >= 0) {
+        shard.waitTime += tick - state.queuedSince;
+        shard.waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - state.queuedAt).count();
+        state.queuedSince = -1;
+    }
+    shard.edges.push_back({train->id, {}});
+}
+
+void ShardedServer::grantWaiters(Shard& shard, int intersectionId, int tick) {
+    Intersection* inter = shard.graph.getIntersection(intersectionId);
+    while (Train* next = shard.graph.grantNext(intersectionId)) {
+        grant(shard, next, inter, tick);
+    }
+    refreshWaitEdges(shard, intersectionId);
+}
+
+// Every train in the wait queue is waiting on whoever currently holds the intersection
+void ShardedServer::refreshWaitEdges(Shard& shard, int intersectionId) {
+    Intersection* inter = shard.graph.getIntersection(intersectionId);
+    for (Train* waiter : inter->wait_queue) {
+        std::vector<int> waitingOn;
+        for (int holderId : shard.graph.holders(intersectionId)) {
+            if (holderId != waiter->id) {
+                waitingOn.push_back(holderId);
+            }
+        }
+        shard.edges.push_back({waiter->id, waitingOn});
+    }
+}
+
+// Runs on the shard's worker. The coordinator has already checked the train and intersection ids.
+void ShardedServer::apply(Shard& shard, const ShardRequest& request) {
+    const msg_request& msg = request.msg;
+    Train* train = trains[msg.train_id];
+    Intersection* inter = shard.graph.getIntersection(msg.intersection_id);
+    TrainState& state = trainState[train->id];
+
+    if (msg.opcode == OP_ACQUIRE) {
+        state.pendingSeq = msg.seq;
+        shard.metrics.onAcquire(train->id);
+        shard.logs.push_back({LOG_TRAIN_REQUEST, request.tick, train->id, inter->id, 0});
+        if (shard.graph.acquire(inter->id, train)) {
+            grant(shard, train, inter, request.tick);
+        } else {
+            shard.logs.push_back({LOG_LOCK, request.tick, train->id, inter->id, 0});
+            shard.metrics.onWait(inter->id);
+            shard.graph.enqueue(inter->id, train);
+            state.queuedSince = request.tick;
+            state.queuedAt = std::chrono::steady_clock::now();
+            refreshWaitEdges(shard, inter->id);
+            shard.queued.push_back(train->id);
+        }
+        return;
+    }
+
+    // RELEASE. A train that releases was granted, which already cleared its edges, so unlike dispatch there is
+    // nothing to clear here. Doing it would race with the shard queueing its next ACQUIRE in the same batch.
+    if (shard.graph.release(inter->id, train)) {
+        shard.logs.push_back({LOG_RELEASE, request.tick, train->id, inter->id, 0});
+        shard.metrics.onRelease(train->id, inter->id);
+        grantWaiters(shard, inter->id, request.tick);
+    } else {
+        shard.logs.push_back({LOG_MESSAGE, request.tick, train->id, inter->id, 0});
+        respond(OP_DENY, train, msg.intersection_id, msg.seq);
+    }
+}
+
+// Writes the shards' log entries in tick order and folds their wait-for edges and totals into the global state
+void ShardedServer::merge() {
+    std::vector<ShardLogEntry> entries;
+    for (auto& shard : shards) {
+        entries.insert(entries.end(), shard->logs.begin(), shard->logs.end());
+        shard->logs.clear();
+
+        for (auto& [trainId, waitingOn] : shard->edges) {
+            if (waitingOn.empty()) {
+                waitingGraph.clearEdges(trainId);
+            } else {
+                waitingGraph.setEdges(trainId, waitingOn);
+            }
+        }
+        shard->edges.clear();
+
+        simStats.grants += shard->grants;
+        simStats.grantsAfterRecovery += shard->grantsAfterRecovery;
+        simStats.waitTime += shard->waitTime;
+        simStats.waitSeconds += shard->waitSeconds;
+        shard->grants = shard->grantsAfterRecovery = 0;
+        shard->waitTime = 0;
+        shard->waitSeconds = 0;
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const ShardLogEntry& a, const ShardLogEntry& b) {
+        return a.tick < b.tick;
+    });
+    for (const ShardLogEntry& entry : entries) {
+        switch (entry.kind) {
+        case LOG_TRAIN_REQUEST:
+            writeLog::logTrainRequest(entry.train_id, entry.intersection_id, entry.tick);
+            break;
+        case LOG_GRANT:
+            writeLog::logGrant(entry.train_id, entry.intersection_id, entry.value, entry.tick);
+            break;
+        case LOG_LOCK:
+            writeLog::logLock(entry.train_id, entry.intersection_id, entry.tick);
+            break;
+        case LOG_RELEASE:
+            writeLog::logRelease(entry.train_id, entry.intersection_id, entry.tick);
+            break;
+        default: {
+            const std::string& trainName = trains[entry.train_id]->name;
+            const std::string& interName = shardOf(entry.intersection_id).graph.getIntersection(entry.intersection_id)->name;
+            writeLog::log("SERVER", "Invalid release request: Train " + trainName + " not found in intersection " + interName, entry.tick);
+            std::cerr << "server.cpp: Invalid release request: Train " << trainName << " not found in intersection " << interName << std::endl;
+            break;
+        }
+        }
+    }
+}
+
+// Preempts a victim from the cycle across all the shards' graphs, then hands what it held to the trains waiting
+// for it. Only runs while the shards are idle.
+void ShardedServer::recover(const std::vector<int>& cycle) {
+    std::vector<ResourceAllocationGraph*> graphs;
+    for (auto& shard : shards) {
+        graphs.push_back(&shard->graph);
+    }
+    Preemption preemption = deadlockRecovery(trains, graphs, cycle, sim_time, victimPolicy);
+    if (preemption.train_id == -1 || preemption.released.empty()) {
+        return;
+    }
+
+    Train* victim = trains[preemption.train_id];
+    TrainState& state = trainState[victim->id];
+    state.queuedSince = -1;
+    waitingGraph.clearEdges(victim->id);
+    simStats.preemptions++;
+    if (simStats.firstRecoveryAt < 0) {
+        simStats.firstRecoveryAt = sim_time;
+    }
+
+    respond(OP_PREEMPT, victim, preemption.released.front(), state.pendingSeq);
+    for (int intersectionId : preemption.released) {
+        shardOf(intersectionId).metrics.onRelease(victim->id, intersectionId);
+        grantWaiters(shardOf(intersectionId), intersectionId, sim_time);
+    }
+    if (preemption.cancelled != -1) {
+        refreshWaitEdges(shardOf(preemption.cancelled), preemption.cancelled);
+    }
+    merge();
+}
+
+// Routes a batch to the shards, runs them, then checks every train they queued for a deadlock. Returns how many
+// trains reported their route complete.
+int ShardedServer::handleBatch(std::vector<msg_request>& batch) {
+    int completed = 0;
+    for (msg_request& msg : batch) {
+        if (msg.train_id < 0 || (size_t)msg.train_id >= trains.size()) {
+            writeLog::log("SERVER", "Invalid request: Unknown train id " + std::to_string(msg.train_id), sim_time);
+            std::cerr << "server.cpp: Invalid request: Unknown train id " << msg.train_id << std::endl;
+            continue;
+        }
+        Train* train = trains[msg.train_id];
+        serverMetrics.onRequest();
+
+        if (msg.opcode == OP_COMPLETE) {
+            completed++;
+            continue;
+        }
+        if (msg.opcode != OP_ACQUIRE && msg.opcode != OP_RELEASE) {
+            writeLog::log("SERVER", "Invalid request: Unknown opcode " + std::to_string(msg.opcode) + " from " + train->name, sim_time);
+            std::cerr << "server.cpp: Invalid request: Unknown opcode " << (int)msg.opcode << " from " << train->name << std::endl;
+            continue;
+        }
+        if (msg.intersection_id < 0 || !shardOf(msg.intersection_id).graph.getIntersection(msg.intersection_id)) {
+            const char* request = msg.opcode == OP_ACQUIRE ? "acquire" : "release";
+            writeLog::log("SERVER", std::string("Invalid ") + request + " request: Intersection not found: " + std::to_string(msg.intersection_id), sim_time);
+            std::cerr << "server.cpp: Invalid " << request << " request: Intersection not found: " << msg.intersection_id << std::endl;
+            respond(OP_DENY, train, msg.intersection_id, msg.seq);
+            continue;
+        }
+
+        if (msg.opcode == OP_ACQUIRE && !externalClock) {
+            sim_time++; // Without a real clock every request is one tick
+        }
+        shardOf(msg.intersection_id).inbox.push_back({msg, sim_time});
+    }
+
+    bool anyWork = false;
+    for (auto& shard : shards) {
+        anyWork = anyWork || !shard->inbox.empty();
+    }
+    if (!anyWork) {
+        return completed;
+    }
+    runShards();
+    merge();
+
+    std::vector<int> queued;
+    for (auto& shard : shards) {
+        queued.insert(queued.end(), shard->queued.begin(), shard->queued.end());
+        shard->queued.clear();
+    }
+    // Checked in arrival order like dispatch does, so the same cycle is found and the same victim picked
+    std::stable_sort(queued.begin(), queued.end(), [this](int a, int b) {
+        return trainState[a].queuedSince < trainState[b].queuedSince;
+    });
+    for (int trainId : queued) {
+        std::vector<int> cycle;
+        if (!waitingGraph.isWaiting(trainId) || !waitingGraph.findCycleThrough(trainId, cycle)) {
+            continue;
+        }
+        std::cout << "Deadlock detected! Handing over to the recovery module...\n";
+        simStats.deadlocks++;
+        std::chrono::steady_clock::time_point recoveryStart = std::chrono::steady_clock::now();
+        recover(cycle);
+        serverMetrics.onDeadlock(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - recoveryStart).count());
+    }
+    return completed;
+}
@@ -0,0 +1,96 @@
+#ifndef SHARD_SERVER_HPP
+#define SHARD_SERVER_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "parsing.hpp"
+#include "ipc.hpp"
+#include "resource_allocation.hpp"
+#include "dispatch.hpp"
+
+// Sharded mode (SERVER_SHARDS=N): the intersections are split over N worker threads by id, intersection id % N.
+// Each worker owns the ResourceAllocationGraph for its intersections and handles the ACQUIREs and RELEASEs for
+// them, so requests for different shards run in parallel. The server thread is the coordinator: it routes every
+// request in a batch to its shard, waits for the shards to finish the batch, then merges their wait-for edges into
+// the global waitingGraph and runs deadlock detection and recovery while the shards are idle. Logging stays on the
+// coordinator too, the shards buffer their entries and they are written in tick order after each batch.
+class ShardedServer {
+    private:
+    // One request for a shard, with the sim_time tick the coordinator gave it
+    struct ShardRequest {
+        msg_request msg;
+        int tick;
+    };
+
+    // A log call made by a shard, written out by the coordinator
+    struct ShardLogEntry {
+        uint8_t kind; // LogKind
+        int tick;
+        int train_id;
+        int intersection_id;
+        int value; // Semaphore count for LOG_GRANT
+    };
+
+    // Server side state of one train. Only the shard owning the intersection the train is asking for touches it.
+    struct TrainState {
+        uint32_t pendingSeq = 0;
+        int queuedSince = -1;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
+    struct Shard {
+        ResourceAllocationGraph graph;
+        std::vector<ShardRequest> inbox;
+        std::vector<ShardLogEntry> logs;
+        std::vector<std::pair<int, std::vector<int>>> edges; // Wait-for edges it set, in order, empty to clear
+        std::vector<int> queued; // Trains it queued this batch
+        int grants = 0;
+        int grantsAfterRecovery = 0;
+        long waitTime = 0;
+        double waitSeconds = 0;
+        ServerMetrics metrics; // Grants, waits and holds for its intersections, the coordinator keeps the rest
+        std::thread worker;
+    };
+
+    std::vector<Train*>& trains;
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<TrainState> trainState;
+
+    std::mutex mutex; // Guards generation, running and stopping
+    std::condition_variable startBatch;
+    std::condition_variable batchDone;
+    unsigned long generation = 0;
+    int running = 0;
+    bool stopping = false;
+
+    std::mutex responseMutex; // Response rings in shared memory have a single producer per train, sinks a single caller
+    bool lockResponses;
+
+    Shard& shardOf(int intersectionId);
+    void workerLoop(Shard& shard);
+    void runShards();
+    void apply(Shard& shard, const ShardRequest& request);
+    void grant(Shard& shard, Train* train, Intersection* inter, int tick);
+    void grantWaiters(Shard& shard, int intersectionId, int tick);
+    void refreshWaitEdges(Shard& shard, int intersectionId);
+    void respond(uint8_t opcode, Train* train, int intersectionId, uint32_t seq);
+    void merge();
+    void recover(const std::vector<int>& cycle);
+
+    public:
+    ShardedServer(std::vector<Train*>& trains, const std::vector<Intersection*>& intersections, int numShards);
+    ~ShardedServer();
+
+    int handleBatch(std::vector<msg_request>& batch);
+    int size() const;
+    void metricsSources(std::vector<const ServerMetrics*>& sources) const;
+};
+
+int serverShardsFromEnv();
+
+#endif
@@ -0,0 +1,226 @@
+#ifndef SHM_RING_HPP
+#define SHM_RING_HPP
+
+#include <atomic>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Bounded lock-free rings that live inside a SysV shared memory segment, used as the shared memory transport in ipc.cpp.
+// Both rings are plain structs with no pointers so they work at any address, and are set up with init() rather than
+// a constructor because the memory is created by shmget. The futex calls are not FUTEX_PRIVATE since the trains are
+// separate processes.
+
+#define RING_CACHE_LINE 64
+#define RING_SPIN_LIMIT 2000 // tryPop attempts before the consumer sleeps on the futex
+
+// Blocks while *word still equals expected, or until timeout if one is given. Returns early on a wake, a signal or
+// a changed value, so callers recheck.
+inline void futex_wait(std::atomic<uint32_t>* word, uint32_t expected, const struct timespec* timeout = nullptr) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t>* word) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+// Wakeup for a ring's consumer. Producers bump signal after every push and only make the wake syscall when the
+// consumer has said it is about to sleep, so an uncontended push never enters the kernel.
+struct RingDoorbell {
+    alignas(RING_CACHE_LINE) std::atomic<uint32_t> signal;
+    std::atomic<uint32_t> sleepers;
+
+    void init() {
+        signal.store(0, std::memory_order_relaxed);
+        sleepers.store(0, std::memory_order_relaxed);
+    }
+
+    void ring() {
+        signal.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_seq_cst) != 0) {
+            futex_wake(&signal);
+        }
+    }
+
+    // Calls tryPop until it succeeds, sleeping on the futex in between. The signal value is read before the
+    // last tryPop, so a push that lands after it changes the value and the wait returns straight away.
+    // Spins briefly first since a reply usually arrives within a few microseconds, unless there is only one CPU
+    // and spinning would just keep the producer from running. With timeoutMs of 0 or more it gives up after that
+    // long and returns false.
+    template <typename TryPop>
+    bool waitFor(TryPop tryPop, int timeoutMs = -1) {
+        static const int spinLimit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? RING_SPIN_LIMIT : 0;
+        for (int spin = 0; spin < spinLimit; ++spin) {
+            if (tryPop()) {
+                return true;
+            }
+        }
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (!tryPop()) {
+            struct timespec remaining;
+            if (timeoutMs >= 0) {
+                auto left = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+                if (left <= 0) {
+                    return false;
+                }
+                remaining.tv_sec = left / 1000000000;
+                remaining.tv_nsec = left % 1000000000;
+            }
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            uint32_t seen = signal.load(std::memory_order_seq_cst);
+            if (!tryPop()) {
+                futex_wait(&signal, seen, timeoutMs >= 0 ? &remaining : nullptr);
+                sleepers.fetch_sub(1, std::memory_order_seq_cst);
+                continue;
+            }
+            sleepers.fetch_sub(1, std::memory_order_seq_cst);
+            return true;
+        }
+        return true;
+    }
+};
+
+// Single producer, single consumer ring. Used for the server's responses to one train.
+template <typename T, size_t N>
+struct SpscRing {
+    static_assert((N & (N - 1)) == 0, "ring capacity must be a power of two");
+
+    alignas(RING_CACHE_LINE) std::atomic<uint32_t> head; // next slot to read, only written by the consumer
+    alignas(RING_CACHE_LINE) std::atomic<uint32_t> tail; // next slot to write, only written by the producer
+    RingDoorbell doorbell;
+    alignas(RING_CACHE_LINE) T slots[N];
+
+    void init() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        doorbell.init();
+    }
+
+    bool tryPush(const T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) {
+            return false; // full
+        }
+        slots[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false; // empty
+        }
+        item = slots[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Number of items waiting, exact for the consumer and at most stale by a few for anyone else
+    uint32_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    // A full ring means the consumer is behind, so just give it the CPU and try again
+    void push(const T& item) {
+        while (!tryPush(item)) {
+            sched_yield();
+        }
+        doorbell.ring();
+    }
+
+    void pop(T& item) {
+        doorbell.waitFor([&] { return tryPop(item); });
+    }
+
+    bool popFor(T& item, int timeoutMs) {
+        return doorbell.waitFor([&] { return tryPop(item); }, timeoutMs);
+    }
+};
+
+// Multiple producer, single consumer ring. Used for every train's requests into the server.
+// Each slot carries a sequence number (as in Vyukov's bounded queue): producers claim a slot with a CAS on tail,
+// fill it, then publish it by setting its sequence, so the consumer never sees a half written slot.
+template <typename T, size_t N>
+struct MpscRing {
+    static_assert((N & (N - 1)) == 0, "ring capacity must be a power of two");
+
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        T item;
+    };
+
+    alignas(RING_CACHE_LINE) std::atomic<uint32_t> head; // only written by the consumer
+    alignas(RING_CACHE_LINE) std::atomic<uint32_t> tail; // claimed by producers with a CAS
+    RingDoorbell doorbell;
+    alignas(RING_CACHE_LINE) Slot slots[N];
+
+    void init() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        doorbell.init();
+        for (uint32_t i = 0; i < N; ++i) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool tryPush(const T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[t & (N - 1)];
+            int32_t diff = (int32_t)(slot.sequence.load(std::memory_order_acquire) - t);
+            if (diff == 0) {
+                // Slot is free for position t, try to claim it
+                if (tail.compare_exchange_weak(t, t + 1, std::memory_order_relaxed)) {
+                    slot.item = item;
+                    slot.sequence.store(t + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // full, the consumer hasn't freed this slot from the previous lap yet
+            } else {
+                t = tail.load(std::memory_order_relaxed); // another producer got here first
+            }
+        }
+    }
+
+    bool tryPop(T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[h & (N - 1)];
+        if ((int32_t)(slot.sequence.load(std::memory_order_acquire) - (h + 1)) < 0) {
+            return false; // empty, or a producer has claimed the slot but not published it yet
+        }
+        item = slot.item;
+        slot.sequence.store(h + N, std::memory_order_release); // free the slot for the next lap
+        head.store(h + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Counts slots claimed but not yet read, including any a producer is still filling
+    uint32_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    void push(const T& item) {
+        while (!tryPush(item)) {
+            sched_yield();
+        }
+        doorbell.ring();
+    }
+
+    void pop(T& item) {
+        doorbell.waitFor([&] { return tryPop(item); });
+    }
+
+    bool popFor(T& item, int timeoutMs) {
+        return doorbell.waitFor([&] { return tryPop(item); }, timeoutMs);
+    }
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+Group: B
+Author: Gavin Zlatar
+Email: gavin.zlatar@okstate.edu
+Date: 10/17/2026
+
+Description: The server side of one simulation run, shared by server.cpp, testserver.cpp and the scenario runner.
+Parses the intersections and trains, forks the trains (or starts them on a thread pool with TRAIN_MODE=threads),
+then takes requests off the queue in batches until every train has completed its route. With SERVER_SHARDS=N the
+batches are applied by a ShardedServer instead of dispatch.cpp.
+*/
+
+#include "simulation.hpp"
+
+// Undoes what a run of runServer left behind, on every way out of it. The graph points into the network arena that
+// goes when runServer returns. IPC set up for a run that then failed has nobody else to remove it, a run that
+// finished leaves it to its caller as before.
+struct ServerRunCleanup {
+    bool ipcSetUp = false;
+    bool finished = false;
+
+    ~ServerRunCleanup() {
+        resourceGraph = ResourceAllocationGraph();
+        if (ipcSetUp && !finished) {
+            clear_resources();
+        }
+    }
+};
+
+int runServer(const std::string& intersectionsPath, const std::string& trainsPath) {
+    if (eventModeFromEnv()) {
+        return runEventDriven(intersectionsPath, trainsPath);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Initialize the resource graph
+    resourceGraph = ResourceAllocationGraph();
+
+    // parse for intersections and train configs, or map them from a compiled topology with TOPOLOGY_FILE. The
+    // objects live in the arena and go with it when this returns, trains from a topology run off its mapping.
+    // Both are indexed by id, one wait-for node per train.
+    Topology topology;
+    NetworkArena arena;
+    vector<Intersection*> intersections;
+    vector<Train*> trainsList;
+    ServerRunCleanup cleanup; // Declared after the arena so it runs first
+    if (!loadNetwork(intersectionsPath, trainsPath, topology, arena, intersections, trainsList)) {
+        std::cerr << "server.cpp: Failed to load the network.\n";
+        return 1;
+    }
+
+    // numTrains and completeTrains track route completion
+    int numTrains = trainsList.size();
+    int completeTrains = 0;
+
+    // add intersections to resource graph
+    for (Intersection* inter : intersections) {
+        resourceGraph.addIntersection(inter);
+    }
+
+    resetDispatch(trainsList.size());
+    registerLogNames(trainsList);
+
+    // In thread mode the trains run on a pool inside this process, so requests go through an in process queue and
+    // responses are handed straight to the pool
+    bool threadMode = threadModeFromEnv();
+    TrainPool pool(trainsList, intersections, threadMode ? trainThreadsFromEnv() : 0);
+
+    // IPC set up
+    if (ipc_setup(trainsList.size(), threadMode ? TRANSPORT_INPROC : ipc_transport_from_env())==-1) {
+        std::cerr << "server.cpp: IPC setup failed.\n";
+        return 1;
+    };
+    cleanup.ipcSetUp = true;
+
+    // Forked trains read their routes from one read-only shared mapping made before the fork, so however many trains
+    // there are they all share its pages and each only keeps a cursor into its route. A compiled topology is mapped
+    // that way already and is handed on as it is, a parsed network is laid out as one here.
+    if (!threadMode && !topology.isOpen() && !topology.share(intersections, trainsList)) {
+        std::cerr << "server.cpp: Sharing the topology failed.\n";
+        return 1;
+    }
+
+    pid_t pid = -1;
+    if (threadMode) {
+        responseSink = [&pool](const msg_request& msg) { pool.deliver(msg); };
+        pool.start();
+    } else {
+        std::cout.flush(); // Don't let the trains inherit buffered output
+        pid = fork();
+        if (pid < 0) {
+            std::cerr << "server.cpp: Forking failed.\n";
+            return 1;
+
+        // PID 0, child process, goes onto train_forking
+        } else if (pid == 0) {
+            train_forking(topology);
+            exit(0);
+        }
+    }
+
+    // With SERVER_SHARDS=N the requests are applied by N shard threads, started after the fork so the trains don't
+    // inherit them. Avoidance checks the whole network at once, so it keeps the single threaded dispatch.
+    int numShards = serverShardsFromEnv();
+    if (numShards > 1 && avoidDeadlocks) {
+        std::cout << "server.cpp: DEADLOCK_MODE=avoid checks the whole network at once, running unsharded.\n";
+        numShards = 1;
+    }
+    std::unique_ptr<ShardedServer> sharded;
+    if (numShards > 1) {
+        sharded.reset(new ShardedServer(trainsList, intersections, numShards));
+    }
+
+    // Only the server logs, so async and binary logging start here where the trains can't inherit the writer
+    // thread or any buffered log
+    writeLog::configureFromEnv();
+
+    // With METRICS_FILE set the server's metrics are written there every METRICS_INTERVAL_MS and once at the end
+    MetricsReporter metrics;
+    std::vector<const ServerMetrics*> metricsSources{&serverMetrics};
+    std::vector<std::string> intersectionNames;
+    if (metrics.configureFromEnv()) {
+        if (sharded) {
+            sharded->metricsSources(metricsSources);
+        }
+        for (int i = 0; i < resourceGraph.size(); ++i) {
+            intersectionNames.push_back(resourceGraph.getIntersection(i)->name);
+        }
+    }
+
+    // With TRACE_FILE set every request received is recorded, in order, for ./replay. Opened after the fork so the
+    // trains don't inherit the file.
+    TraceWriter trace;
+    trace.configureFromEnv(trainsList.size(), resourceGraph.size());
+
+    std::ostringstream intersectionLog;
+    intersectionLog << "Initialized intersections:\n";
+
+    // Format log like project document
+    for (Intersection* inter : intersections)
+    {
+        intersectionLog << "- " << inter->name << " (";
+        intersectionLog << (inter->is_mutex ? "Mutex" : "Semaphore") << ", Capacity=" << inter->capacity << ")\n";
+    }
+
+    // Log the initialized intersections
+    writeLog::log("SERVER", intersectionLog.str(), sim_time);
+
+    std::cout << "server.cpp: Server started...\n";
+
+    // main loop
+    vector<msg_request> batch;
+    while (completeTrains < numTrains) {
+        // wait for a request, then take every other request already waiting so they are handled together
+        // With metrics on the wait ends when the next dump is due, so a server with nothing to do still writes them
+        int receive_success = receive_batch(requestQueueId, batch, MAX_REQUEST_BATCH, MSG_TYPE_DEFAULT, metrics.msUntilDue());
+        if (receive_success == -1) {
+            std::cerr << "server.cpp: Failed to receive message.\n";
+            continue; // Retry if receiving the message fails
+        }
+        if (receive_success == 0) {
+            if (metrics.due()) {
+                metrics.dump(metricsSources, intersectionNames, sim_time, queue_depth(requestQueueId));
+            }
+            continue;
+        }
+        for (const msg_request& msg : batch) {
+            std::cout << "server.cpp: Received message: " << msg.train_id << " " << opcode_name(msg.opcode) << " " << msg.intersection_id << " " << msg.mtype << std::endl;
+        }
+        trace.record(batch);
+
+        // Apply the batch, queued trains are granted by the release that frees their intersection
+        // Trains that completed their route are added to completeTrains
+        completeTrains += sharded ? sharded->handleBatch(batch) : handleBatch(batch, trainsList);
+        if (metrics.due()) {
+            metrics.dump(metricsSources, intersectionNames, sim_time, queue_depth(requestQueueId));
+        }
+    }
+    metrics.dump(metricsSources, intersectionNames, sim_time, queue_depth(requestQueueId));
+    sharded.reset();
+    trace.close();
+
+    // If all trains completed, log simualtion complete then exit
+    simStats.makespan = sim_time;
+    writeLog::logSimulationComplete(sim_time);
+    std::cout << "All trains have completed their routes.\n";
+
+    if (threadMode) {
+        pool.stop(); // Every train has sent COMPLETE, so the workers are idle
+        responseSink = nullptr;
+    } else {
+        waitpid(pid, nullptr, 0); // Wait for the train processes to exit
+    }
+    cleanup.finished = true;
+    simStats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include <string>
+#include "parsing.hpp"
+#include "logging.hpp"
+#include "ipc.hpp"
+#include "train.hpp"
+#include "dispatch.hpp"
+#include "event_sim.hpp"
+#include "train_pool.hpp"
+#include "shard_server.hpp"
+#include "trace.hpp"
+
+// Runs one whole simulation: parses the config, forks the trains and serves their requests until every train has
+// completed its route. Totals are left in simStats. Returns 0 on success. With SIM_MODE=event the trains are
+// simulated in process by runEventDriven instead,
+// and with TRAIN_MODE=threads they run on a TrainPool in this process. SERVER_SHARDS=N splits the intersections over
+// N server threads, and TRACE_FILE records every request it receives for replayTrace.
+int runServer(const std::string& intersectionsPath = "intersections.txt", const std::string& trainsPath = "trains.txt");
+
+#endif
@@ -1 +1 @@
-g++ -o test testing.cpp testserver.cpp ipc.cpp parsing.cpp train.cpp deadlock_recovery.cpp logging.cpp resource_allocation.cpp -std=c++17
+g++ -o test testing.cpp testserver.cpp simulation.cpp event_sim.cpp ipc.cpp parsing.cpp train.cpp train_pool.cpp deadlock_recovery.cpp logging.cpp resource_allocation.cpp dispatch.cpp shard_server.cpp deadlock_detection.cpp deadlock_avoidance.cpp metrics.cpp topology.cpp trace.cpp -std=c++17
@@ -15,8 +15,13 @@ Description: Performs various tests on each unit, then a system test.
 #include <string>
 #include <set>
 #include <cstring>
+#include <csignal>
+#include <iterator>
 
 #include "testserver.hpp"
+#include "admission.hpp"
+#include "topology.hpp"
+#include "trace.hpp"
 
 // Initialize the numIntersection and numTrains to be used in base config and tests
 int numIntersections;
@@ -134,13 +139,25 @@ void generateConfig()
     trainsFile.close();
 }
 
+// Config using the optional timing fields: crossing times, a departure time and travel times between hops
+void generateTimedConfig()
+{
+    std::ofstream intersectionsFile("timed_intersections.txt");
+    intersectionsFile << "IntersectionA:1:2500\nIntersectionB:2\n";
+    intersectionsFile.close();
+    std::ofstream trainsFile("timed_trains.txt");
+    trainsFile << "Train1@1000:IntersectionA+500,IntersectionB+2000\nTrain2:IntersectionA\n";
+    trainsFile.close();
+}
+
 // Test 1: Parsing, should read the intersections.txt and trains.txt file into objects with basic methods.
 // checks variables numIntersections and numTrains to see if they were parsed correctly
 void parsing_test()
 {
-    // Parse files
-    auto intersections = parseIntersections("intersections.txt");
-    auto trains = parseTrains("trains.txt", intersections);
+    // Parse files, everything parsed here belongs to arena
+    NetworkArena arena;
+    auto intersections = parseIntersections("intersections.txt", arena);
+    auto trains = parseTrains("trains.txt", intersections, arena);
 
     if (intersections.size() == numIntersections)
     {
@@ -158,6 +175,206 @@ void parsing_test()
     {
         std::cerr << "testing.cpp: ERROR Parsing Trains" << std::endl;
     }
+
+    // Timing fields are optional, anything left out keeps the old one second crossing and no travel time
+    generateTimedConfig();
+    auto timedIntersections = parseIntersections("timed_intersections.txt", arena);
+    auto timedTrains = parseTrains("timed_trains.txt", timedIntersections, arena);
+    if (timedIntersections["IntersectionA"]->crossing_ms == 2500 && timedIntersections["IntersectionB"]->crossing_ms == DEFAULT_CROSSING_MS &&
+        timedTrains["Train1"]->departure_ms == 1000 && timedTrains["Train1"]->route.size() == 2 &&
+        timedTrains["Train1"]->travel_ms == std::vector<uint32_t>{500, 2000} &&
+        timedTrains["Train2"]->departure_ms == 0 && timedTrains["Train2"]->travel_ms == std::vector<uint32_t>{0})
+    {
+        std::cout << "testing.cpp: SUCCESS Parsing timings" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Parsing timings" << std::endl;
+    }
+    remove("timed_intersections.txt");
+    remove("timed_trains.txt");
+
+    // Windows line endings, blank lines, padding and no newline at the end all parse the same as a clean file
+    std::ofstream messyIntersections("messy_intersections.txt");
+    messyIntersections << "IntersectionA : 1\r\n\r\n  IntersectionB:2:750\r\n";
+    messyIntersections.close();
+    std::ofstream messyTrains("messy_trains.txt");
+    messyTrains << "\nTrain1#3 : IntersectionA , IntersectionB+250\r\nTrain2:IntersectionB";
+    messyTrains.close();
+    auto messyIntersectionMap = parseIntersections("messy_intersections.txt", arena);
+    auto messyTrainMap = parseTrains("messy_trains.txt", messyIntersectionMap, arena);
+    if (messyIntersectionMap.size() == 2 && messyIntersectionMap["IntersectionA"]->capacity == 1 &&
+        messyIntersectionMap["IntersectionB"]->crossing_ms == 750 && messyTrainMap.size() == 2 &&
+        messyTrainMap["Train1"]->priority == 3 && messyTrainMap["Train1"]->route.size() == 2 &&
+        messyTrainMap["Train1"]->travel_ms == std::vector<uint32_t>{0, 250} && messyTrainMap["Train2"]->id == 1 &&
+        messyTrainMap["Train2"]->route.size() == 1)
+    {
+        std::cout << "testing.cpp: SUCCESS Parsing messy files" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Parsing messy files" << std::endl;
+    }
+    remove("messy_intersections.txt");
+    remove("messy_trains.txt");
+
+    // Bad entries are counted and left out: an intersection nobody could cross, numbers past an int, empty route
+    // entries from doubled or trailing commas, which aren't reported as an intersection that doesn't exist, and
+    // trains with only a departure time or priority where the name goes
+    std::ofstream badIntersections("bad_intersections.txt");
+    badIntersections << "IntersectionA:1\nIntersectionZero:0\nIntersectionB:2:99999999999\n";
+    badIntersections.close();
+    std::ofstream badTrains("bad_trains.txt");
+    badTrains << "Train1:IntersectionA,IntersectionB,\nTrain2@2147483648:IntersectionA, ,+5,IntersectionB\n@100:IntersectionA\n#3:IntersectionB\n";
+    badTrains.close();
+    int intersectionErrors = 0, trainErrors = 0;
+    auto badIntersectionMap = parseIntersections("bad_intersections.txt", arena, &intersectionErrors);
+    auto badTrainMap = parseTrains("bad_trains.txt", badIntersectionMap, arena, &trainErrors);
+    if (intersectionErrors == 2 && badIntersectionMap.size() == 2 && !badIntersectionMap.count("IntersectionZero") &&
+        badIntersectionMap["IntersectionB"]->id == 1 && badIntersectionMap["IntersectionB"]->crossing_ms == DEFAULT_CROSSING_MS &&
+        trainErrors == 6 && badTrainMap.size() == 2 && badTrainMap["Train1"]->route == std::vector<uint32_t>{0, 1} &&
+        badTrainMap["Train2"]->route == std::vector<uint32_t>{0, 1} && badTrainMap["Train2"]->departure_ms == 0)
+    {
+        std::cout << "testing.cpp: SUCCESS Parsing bad entries" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Parsing bad entries" << std::endl;
+    }
+    remove("bad_intersections.txt");
+    remove("bad_trains.txt");
+
+    // Parsed routes are intersection ids in the arena, next to each other, a train made on its own keeps a copy
+    Intersection loose("IntersectionA", 1, 7);
+    Train looseTrain("Train1", {&loose});
+    uintptr_t firstRoute = (uintptr_t)timedTrains["Train1"]->route.begin();
+    uintptr_t secondRoute = (uintptr_t)timedTrains["Train2"]->route.begin();
+    if (timedTrains["Train1"]->route == std::vector<uint32_t>{0, 1} && secondRoute - firstRoute < NETWORK_ARENA_BLOCK &&
+        looseTrain.route == std::vector<uint32_t>{7} && looseTrain.travel_ms == std::vector<uint32_t>{0})
+    {
+        std::cout << "testing.cpp: SUCCESS Parsing into the arena" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Parsing into the arena" << std::endl;
+    }
+}
+
+// Test 1b: Topology, compiles the configs to a binary topology and runs from it. A route through an unknown
+// intersection fails the compile and a file cut short is refused when it is opened.
+void topology_test()
+{
+    generateTimedConfig();
+    bool compiled = compileTopology("timed_intersections.txt", "timed_trains.txt", "test_topology.bin");
+    Topology topology;
+    NetworkArena arena;
+    std::vector<Intersection*> intersections;
+    std::vector<Train*> trains;
+    bool loaded = compiled && loadTopology("test_topology.bin", topology, arena, intersections, trains);
+
+    // The trains run off the mapped routes, with the same timings as running from the text files in the event
+    // driven test
+    setenv("TOPOLOGY_FILE", "test_topology.bin", 1);
+    if (loaded && intersections.size() == 2 && trains.size() == 2 && trains[0]->name == "Train1" && intersections[1]->name == "IntersectionB" &&
+        trains[0]->route[1] == 1 && trains[0]->route.begin() == topology.route(topology.train(0)) && trains[0]->travel_ms == std::vector<uint32_t>{500, 2000} &&
+        runEventDriven("missing_intersections.txt", "missing_trains.txt") == 0 && simStats.makespan == 8 && simStats.waitTime == 1)
+    {
+        std::cout << "testing.cpp: SUCCESS Topology round trip" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Topology round trip" << std::endl;
+    }
+    unsetenv("TOPOLOGY_FILE");
+
+    std::ofstream badTrains("bad_trains.txt");
+    badTrains << "Train1:IntersectionA,IntersectionZ\n";
+    badTrains.close();
+    bool rejected = !compileTopology("timed_intersections.txt", "bad_trains.txt", "bad_topology.bin") && !std::ifstream("bad_topology.bin");
+
+    std::ifstream whole("test_topology.bin", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(whole)), std::istreambuf_iterator<char>());
+    std::ofstream cut("cut_topology.bin", std::ios::binary);
+    cut.write(bytes.data(), bytes.size() / 2);
+    cut.close();
+    Topology truncated;
+    rejected = rejected && !truncated.open("cut_topology.bin");
+
+    // A hop naming an intersection that isn't there, or a name running off the end of the strings, is refused
+    // before anything reads through it
+    TopologyLayout layout(*reinterpret_cast<const TopologyHeader*>(bytes.data()));
+    std::string badHop = bytes;
+    reinterpret_cast<uint32_t*>(&badHop[layout.hops])[1] = 2;
+    std::string badName = bytes;
+    reinterpret_cast<TopologyTrain*>(&badName[layout.trains])[1].nameLength = 1000;
+    for (const std::string& damaged : {badHop, badName})
+    {
+        std::ofstream damagedFile("damaged_topology.bin", std::ios::binary);
+        damagedFile.write(damaged.data(), damaged.size());
+        damagedFile.close();
+        Topology damagedTopology;
+        rejected = rejected && !damagedTopology.open("damaged_topology.bin");
+    }
+    remove("damaged_topology.bin");
+    if (rejected)
+    {
+        std::cout << "testing.cpp: SUCCESS Topology rejects bad input" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Topology rejects bad input" << std::endl;
+    }
+
+    // Forked trains see the server's network through the shared mapping, and writing to it kills the writer
+    // instead of quietly copying the page
+    Topology shared;
+    bool sharedOk = loaded && shared.share(intersections, trains);
+    pid_t pid = sharedOk ? fork() : -1;
+    if (pid == 0)
+    {
+        const TopologyTrain& train1 = shared.train(0);
+        if (shared.name(train1) != "Train1" || train1.hopCount != 2 || shared.route(train1)[1] != (uint32_t)intersections[1]->id)
+        {
+            _exit(1);
+        }
+        const_cast<uint32_t*>(shared.route(train1))[0] = 1;
+        _exit(0);
+    }
+    int status = 0;
+    if (pid > 0)
+    {
+        waitpid(pid, &status, 0);
+    }
+    if (pid > 0 && WIFSIGNALED(status) && WTERMSIG(status) == SIGSEGV)
+    {
+        std::cout << "testing.cpp: SUCCESS Shared topology read only" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Shared topology read only" << std::endl;
+    }
+
+    remove("bad_trains.txt");
+    remove("cut_topology.bin");
+    remove("test_topology.bin");
+    remove("timed_intersections.txt");
+    remove("timed_trains.txt");
+}
+
+// An empty request queue times out after about as long as asked, then a waiting message comes back with no wait
+bool timedReceiveWorks()
+{
+    std::vector<msg_request> batch;
+    auto start = std::chrono::steady_clock::now();
+    int timedOut = receive_batch(requestQueueId, batch, MAX_REQUEST_BATCH, MSG_TYPE_DEFAULT, 20);
+    auto waited = std::chrono::steady_clock::now() - start;
+    msg_request msg = {};
+    msg.mtype = MSG_TYPE_DEFAULT;
+    msg.opcode = OP_ACQUIRE;
+    msg.seq = 7;
+    send_msg(requestQueueId, msg);
+    int received = receive_batch(requestQueueId, batch, MAX_REQUEST_BATCH, MSG_TYPE_DEFAULT, 1000);
+    return timedOut == 0 && waited >= std::chrono::milliseconds(20) && waited < std::chrono::seconds(1) && received == 1 && batch[0].seq == 7;
 }
 
 // Test 2: ipc setup, function returns 0 if successful. Then sends "TEST" through request queue and recieves through response queue
@@ -178,12 +395,10 @@ void ipc_test()
     // Test message
     msg_request testMsg;
     testMsg.mtype = MSG_TYPE_DEFAULT;
-    strcpy(testMsg.command, "TEST");
-    strcpy(testMsg.intersection, "IntersectionA");
-    for (int i = 0; i < 20; ++i)
-    {
-        testMsg.train_name[i] = i;
-    }
+    testMsg.opcode = OP_ACQUIRE;
+    testMsg.seq = 7;
+    testMsg.train_id = 3;
+    testMsg.intersection_id = 0; // IntersectionA
 
     // Send the message
     int sendResult = send_msg(requestQueueId, testMsg);
@@ -212,8 +427,8 @@ void ipc_test()
         return;
     }
 
-    // Validate message content (TEST, on IntersectionA)
-    if (strcmp(receivedMsg.command, "TEST") == 0)
+    // Validate message content (ACQUIRE, from Train4 on IntersectionA)
+    if (receivedMsg.opcode == OP_ACQUIRE && receivedMsg.seq == 7)
     {
         std::cout << "testing.cpp: SUCCESS message command" << std::endl;
     }
@@ -222,7 +437,7 @@ void ipc_test()
         std::cerr << "testing.cpp: ERROR message command" << std::endl;
     }
 
-    if (strcmp(receivedMsg.intersection, "IntersectionA") == 0)
+    if (receivedMsg.intersection_id == 0 && receivedMsg.train_id == 3)
     {
         std::cout << "testing.cpp: SUCCESS message Intersection" << std::endl;
     }
@@ -230,6 +445,200 @@ void ipc_test()
     {
         std::cerr << "testing.cpp: ERROR message Intersection" << std::endl;
     }
+
+    // Addressed responses: each train only receives replies sent to its own mtype
+    msg_request firstReply = testMsg;
+    firstReply.mtype = TRAIN_REPLY_TYPE(0);
+    firstReply.intersection_id = 0;
+    msg_request secondReply = testMsg;
+    secondReply.mtype = TRAIN_REPLY_TYPE(1);
+    secondReply.intersection_id = 1;
+    send_msg(responseQueueId, firstReply);
+    send_msg(responseQueueId, secondReply);
+
+    // Train id 1 reads first even though train id 0's reply is ahead of it in the queue
+    msg_request addressedMsg;
+    receive_msg(responseQueueId, addressedMsg, TRAIN_REPLY_TYPE(1));
+    bool secondOk = addressedMsg.intersection_id == 1;
+    receive_msg(responseQueueId, addressedMsg, TRAIN_REPLY_TYPE(0));
+    bool firstOk = addressedMsg.intersection_id == 0;
+
+    if (firstOk && secondOk)
+    {
+        std::cout << "testing.cpp: SUCCESS addressed responses" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR addressed responses" << std::endl;
+    }
+
+    // Wire format: a frame without the magic/version header is dropped and the next valid frame is returned
+    struct
+    {
+        long mtype;
+        char command[10];
+        int train_id;
+        int intersection_id;
+    } oldFrame = {MSG_TYPE_DEFAULT, "ACQUIRE", 3, 0};
+    msgsnd(requestQueueId, &oldFrame, sizeof(oldFrame) - sizeof(long), 0);
+    send_msg(requestQueueId, testMsg);
+
+    msg_request validMsg;
+    receive_msg(requestQueueId, validMsg);
+    if (validMsg.magic == MSG_MAGIC && validMsg.version == MSG_VERSION && validMsg.seq == 7)
+    {
+        std::cout << "testing.cpp: SUCCESS rejected old wire format" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR rejected old wire format" << std::endl;
+    }
+
+    // Batched receive: everything already waiting comes back in one call, in order, capped at maxBatch
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        testMsg.seq = i;
+        send_msg(requestQueueId, testMsg);
+    }
+    std::vector<msg_request> batch;
+    int firstBatch = receive_batch(requestQueueId, batch, 3);
+    bool batchOk = firstBatch == 3 && batch[0].seq == 0 && batch[2].seq == 2;
+    int secondBatch = receive_batch(requestQueueId, batch, MAX_REQUEST_BATCH);
+    batchOk = batchOk && secondBatch == 2 && batch[0].seq == 3 && batch[1].seq == 4;
+    msg_request emptyMsg;
+    batchOk = batchOk && try_receive_msg(requestQueueId, emptyMsg) == -1 && errno == ENOMSG;
+
+    if (batchOk)
+    {
+        std::cout << "testing.cpp: SUCCESS batched receive" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR batched receive" << std::endl;
+    }
+
+    // Timed receive: gives up with an empty batch once the timeout is up, and takes a waiting message straight away
+    if (timedReceiveWorks())
+    {
+        std::cout << "testing.cpp: SUCCESS timed receive" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR timed receive" << std::endl;
+    }
+
+    // Key prefix: a second set of queues is separate from the default one, as each runner scenario gets
+    int defaultQueueId = requestQueueId;
+    ipc_set_key_prefix("/tmp/ipc_test_isolated");
+    ipc_setup();
+    int isolatedQueueId = requestQueueId;
+    send_msg(isolatedQueueId, testMsg);
+    bool isolatedOk = isolatedQueueId != defaultQueueId && try_receive_msg(defaultQueueId, emptyMsg) == -1 &&
+        try_receive_msg(isolatedQueueId, emptyMsg) != -1;
+    clear_resources();
+    ipc_set_key_prefix(IPC_KEY_PREFIX);
+    ipc_setup();
+
+    if (isolatedOk)
+    {
+        std::cout << "testing.cpp: SUCCESS isolated IPC keys" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR isolated IPC keys" << std::endl;
+    }
+}
+
+// Test 2b: shared memory transport. A forked "train" echoes requests back through its own response ring
+void shm_transport_test()
+{
+    if (ipc_setup(2, TRANSPORT_SHM) == 0 && ipc_transport == TRANSPORT_SHM)
+    {
+        std::cout << "testing.cpp: SUCCESS Shared memory setup" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Shared memory setup" << std::endl;
+        return;
+    }
+
+    const int numMessages = 1000;
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        // Train id 1: answer every response with a request carrying the same seq
+        msg_request msg;
+        for (int i = 0; i < numMessages; ++i)
+        {
+            receive_msg(responseQueueId, msg, TRAIN_REPLY_TYPE(1));
+            msg.mtype = MSG_TYPE_DEFAULT;
+            msg.opcode = OP_RELEASE;
+            send_msg(requestQueueId, msg);
+        }
+        exit(0);
+    }
+
+    // Send everything first so the child has to wake up on a ring that is already full of work
+    msg_request msg;
+    msg.mtype = TRAIN_REPLY_TYPE(1);
+    msg.opcode = OP_GRANT;
+    msg.train_id = 1;
+    msg.intersection_id = 0;
+    bool inOrder = true;
+    for (int i = 0; i < numMessages; ++i)
+    {
+        msg.seq = i;
+        send_msg(responseQueueId, msg);
+        if (i % 32 == 31)
+        {
+            // Drain the echoes so the response ring never fills
+            for (int j = i - 31; j <= i; ++j)
+            {
+                msg_request echo;
+                receive_msg(requestQueueId, echo);
+                inOrder = inOrder && echo.seq == (uint32_t)j && echo.opcode == OP_RELEASE && echo.magic == MSG_MAGIC;
+            }
+        }
+    }
+    for (int j = numMessages - numMessages % 32; j < numMessages; ++j)
+    {
+        msg_request echo;
+        receive_msg(requestQueueId, echo);
+        inOrder = inOrder && echo.seq == (uint32_t)j;
+    }
+    waitpid(pid, nullptr, 0);
+
+    if (inOrder)
+    {
+        std::cout << "testing.cpp: SUCCESS Shared memory round trip" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Shared memory round trip" << std::endl;
+    }
+
+    if (timedReceiveWorks())
+    {
+        std::cout << "testing.cpp: SUCCESS Shared memory timed receive" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Shared memory timed receive" << std::endl;
+    }
+
+    // Train id 5 doesn't exist, so there is no ring to send to
+    msg.mtype = TRAIN_REPLY_TYPE(5);
+    if (send_msg(responseQueueId, msg) == -1)
+    {
+        std::cout << "testing.cpp: SUCCESS Shared memory unknown train" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Shared memory unknown train" << std::endl;
+    }
+
+    // Back to the message queues for the rest of the tests
+    ipc_setup(0, TRANSPORT_MSGQ);
 }
 
 // Test 3: allocation table. Creates and uses ResourceAllocationGraph methods and prints a full table
@@ -248,19 +657,23 @@ void allocation_table_test()
 
     // Create test trains
     std::vector<Intersection *> emptyRoute;
-    Train train1("Train1", emptyRoute);
-    Train train2("Train2", emptyRoute);
+    Train train1("Train1", emptyRoute, 0);
+    Train train2("Train2", emptyRoute, 1);
+
+    // Intersections are addressed by the id the graph gave them
+    int idA = resourceGraph.getIntersection("IntersectionA")->id;
+    int idB = resourceGraph.getIntersection("IntersectionB")->id;
 
     // Test aquire intersection through resourceGraph
-    resourceGraph.acquire("IntersectionA", &train1);
-    resourceGraph.acquire("IntersectionB", &train1);
-    resourceGraph.acquire("IntersectionB", &train2);
+    resourceGraph.acquire(idA, &train1);
+    resourceGraph.acquire(idB, &train1);
+    resourceGraph.acquire(idB, &train2);
 
-    // Get resource table method: unordered map of vector strings.
+    // Get resource table method: train ids held, indexed by intersection id.
     auto resourceTable = resourceGraph.getResourceGraph();
 
     // Validate IntersectionA, mutex with 1 train
-    if (resourceTable["IntersectionA"].size() == 1 && resourceTable["IntersectionA"][0] == "Train1")
+    if (resourceTable[idA].size() == 1 && resourceTable[idA][0] == train1.id)
     {
         std::cout << "testing.cpp: SUCCESS Table include IntersectionA" << std::endl;
     }
@@ -270,9 +683,9 @@ void allocation_table_test()
     }
 
     // Validate IntersectionB, semaphore with 2 trains
-    if (resourceTable["IntersectionB"].size() == 2 &&
-        resourceTable["IntersectionB"][0] == "Train1" &&
-        resourceTable["IntersectionB"][1] == "Train2")
+    if (resourceTable[idB].size() == 2 &&
+        resourceTable[idB][0] == train1.id &&
+        resourceTable[idB][1] == train2.id)
     {
         std::cout << "testing.cpp: SUCCESS Table include IntersectionB" << std::endl;
     }
@@ -281,18 +694,29 @@ void allocation_table_test()
         std::cerr << "testing.cpp: ERROR Table include IntersectionB" << std::endl;
     }
 
+    // Each train's holdings come out of the same table
+    if (resourceGraph.heldBy(train1.id).size() == 2 && resourceGraph.heldBy(train2.id).size() == 1 &&
+        resourceGraph.holds(idB, train2.id) && !resourceGraph.holds(idA, train2.id))
+    {
+        std::cout << "testing.cpp: SUCCESS Table holdings per train" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Table holdings per train" << std::endl;
+    }
+
     // Print table
     std::cout << "testing.cpp: Resource table:" << std::endl;
     resourceGraph.printGraph();
 
     // Release intersections
-    resourceGraph.release("IntersectionA", &train1);
-    resourceGraph.release("IntersectionB", &train1);
-    resourceGraph.release("IntersectionB", &train2);
+    resourceGraph.release(idA, &train1);
+    resourceGraph.release(idB, &train1);
+    resourceGraph.release(idB, &train2);
 
     // Validate resource table after release, should be an empty field
     resourceTable = resourceGraph.getResourceGraph();
-    if (resourceTable["IntersectionA"].empty() && resourceTable["IntersectionB"].empty())
+    if (resourceTable[idA].empty() && resourceTable[idB].empty())
     {
         std::cout << "testing.cpp: SUCCESS Table emptied" << std::endl;
     }
@@ -300,19 +724,185 @@ void allocation_table_test()
     {
         std::cerr << "testing.cpp: ERROR Table emptied" << std::endl;
     }
+
+    // A train id past the first word of the bitset rows widens the table, the view is live so it sees the change
+    Train train3("Train3", emptyRoute, 130);
+    resourceGraph.acquire(idB, &train3);
+    if (resourceTable[idB].size() == 1 && resourceTable[idB][0] == train3.id && !resourceGraph.release(idA, &train3))
+    {
+        std::cout << "testing.cpp: SUCCESS Table grows with train ids" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Table grows with train ids" << std::endl;
+    }
+}
+
+// Test 3b: wait queue. A blocked train is queued and granted in FIFO order once the holder releases
+void wait_queue_test()
+{
+    ResourceAllocationGraph resourceGraph;
+    Intersection intersectionA("IntersectionA", 1); // Mutex
+    resourceGraph.addIntersection(&intersectionA);
+
+    std::vector<Intersection *> emptyRoute;
+    Train train1("Train1", emptyRoute, 0);
+    Train train2("Train2", emptyRoute, 1);
+    Train train3("Train3", emptyRoute, 2);
+    int idA = intersectionA.id;
+
+    // Train1 holds the intersection, Train2 then Train3 queue behind it
+    resourceGraph.acquire(idA, &train1);
+    if (!resourceGraph.acquire(idA, &train2))
+    {
+        resourceGraph.enqueue(idA, &train2);
+    }
+    if (!resourceGraph.acquire(idA, &train3))
+    {
+        resourceGraph.enqueue(idA, &train3);
+    }
+
+    // Nobody is granted while Train1 still holds it
+    bool heldOk = resourceGraph.grantNext(idA) == nullptr;
+
+    // Releasing hands the intersection to the front of the queue only
+    resourceGraph.release(idA, &train1);
+    Train *first = resourceGraph.grantNext(idA);
+    Train *second = resourceGraph.grantNext(idA);
+
+    if (heldOk && first == &train2 && second == nullptr && intersectionA.wait_queue.size() == 1)
+    {
+        std::cout << "testing.cpp: SUCCESS Wait queue grant order" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Wait queue grant order" << std::endl;
+    }
+
+    // A newcomer can't take a free slot ahead of a queued train
+    resourceGraph.release(idA, &train2);
+    Train train4("Train4", emptyRoute, 3);
+    bool jumpedQueue = resourceGraph.acquire(idA, &train4);
+    Train *third = resourceGraph.grantNext(idA);
+
+    if (!jumpedQueue && third == &train3)
+    {
+        std::cout << "testing.cpp: SUCCESS Wait queue fairness" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Wait queue fairness" << std::endl;
+    }
+}
+
+// Test 3c: concurrent admission. The lock-free admission word follows the same rules as the graph's wait queue, and
+// several threads sharing one intersection never put more trains in it than its capacity
+void concurrent_admission_test()
+{
+    // One thread: Train0 holds a mutex intersection, Train1 queues and is handed the unit, Train2 can't jump ahead
+    IntersectionAdmission admission(1, 4);
+    bool first = admission.acquireOrWait(0);
+    bool queued = !admission.acquireOrWait(1);
+    int handedTo = admission.release();
+    bool blocked = !admission.tryAcquire();
+    int freed = admission.release();
+    if (first && queued && handedTo == 1 && blocked && freed == -1 && admission.inUse() == 0 && admission.waiting() == 0)
+    {
+        std::cout << "testing.cpp: SUCCESS Admission hand off" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Admission hand off" << std::endl;
+    }
+
+    // A FIFO with room for two waiters: Train3 can't queue behind Train1 and Train2 until the release that hands
+    // Train1 the unit makes room, and then it is handed a unit in turn instead of being lost
+    IntersectionAdmission small(1, 2);
+    small.acquireOrWait(0);
+    small.acquireOrWait(1);
+    small.acquireOrWait(2);
+    std::atomic<bool> lastQueued(false);
+    std::thread last([&]()
+    {
+        lastQueued.store(!small.acquireOrWait(3));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    int toSecond = small.release();
+    last.join();
+    int toThird = small.release();
+    int toLast = small.release();
+    int freedLast = small.release();
+    if (lastQueued.load() && toSecond == 1 && toThird == 2 && toLast == 3 && freedLast == -1 && small.inUse() == 0 && small.waiting() == 0)
+    {
+        std::cout << "testing.cpp: SUCCESS Admission past the waiter limit" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Admission past the waiter limit" << std::endl;
+    }
+
+    // Four threads crossing a capacity two intersection, each waiting to be handed a unit when it is full
+    const int numThreads = 4, crossings = 2000;
+    IntersectionAdmission shared(2, numThreads);
+    std::atomic<bool> granted[numThreads];
+    std::atomic<int> inside(0), mostInside(0);
+    for (auto &flag : granted)
+    {
+        flag.store(false);
+    }
+    std::vector<std::thread> threads;
+    for (int id = 0; id < numThreads; ++id)
+    {
+        threads.emplace_back([&, id]()
+        {
+            for (int i = 0; i < crossings; ++i)
+            {
+                if (!shared.acquireOrWait(id))
+                {
+                    while (!granted[id].exchange(false, std::memory_order_acquire))
+                    {
+                        sched_yield();
+                    }
+                }
+                int now = ++inside;
+                int most = mostInside.load();
+                while (now > most && !mostInside.compare_exchange_weak(most, now))
+                {
+                }
+                --inside;
+                int next = shared.release();
+                if (next != -1)
+                {
+                    granted[next].store(true, std::memory_order_release);
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    if (mostInside.load() <= 2 && shared.inUse() == 0 && shared.waiting() == 0)
+    {
+        std::cout << "testing.cpp: SUCCESS Concurrent admission" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Concurrent admission, " << mostInside.load() << " trains inside at once" << std::endl;
+    }
 }
 
 // Test 4: Deadlock detection and recovery
 void deadlock_recovery_test() {
     // Create test intersections
-    Intersection intersectionA("IntersectionA", 1); // Mutex
-    Intersection intersectionB("IntersectionB", 1); // Mutex
+    Intersection intersectionA("IntersectionA", 1, 0); // Mutex
+    Intersection intersectionB("IntersectionB", 1, 1); // Mutex
 
     // Create test trains with routes
     std::vector<Intersection*> route1 = {&intersectionA, &intersectionB};
     std::vector<Intersection*> route2 = {&intersectionB, &intersectionA};
-    Train train1("Train1", route1);
-    Train train2("Train2", route2);
+    Train train1("Train1", route1, 0);
+    Train train2("Train2", route2, 1);
 
     // Create resource graph
     ResourceAllocationGraph resourceGraph;
@@ -320,37 +910,49 @@ void deadlock_recovery_test() {
     resourceGraph.addIntersection(&intersectionB);
 
     // Simulate resource acquiring, then make a cycle in wait graph
-    resourceGraph.acquire("IntersectionA", &train1);
-    resourceGraph.acquire("IntersectionB", &train2);
+    resourceGraph.acquire(intersectionA.id, &train1);
+    resourceGraph.acquire(intersectionB.id, &train2);
 
-    std::unordered_map<std::string, std::vector<std::string>> waitingGraph;
-    waitingGraph["Train1"].push_back("Train2"); // Train1 is waiting for Train2
-    waitingGraph["Train2"].push_back("Train1"); // Train2 is waiting for Train1
+    WaitForGraph waitingGraph;
+    waitingGraph.resize(2);
+    waitingGraph.setEdges(train1.id, {train2.id}); // Train1 is waiting for Train2
+    waitingGraph.setEdges(train2.id, {train1.id}); // Train2 is waiting for Train1
 
     // Detect deadlock using the waiting graph
-    std::vector<std::string> cycle;
+    std::vector<int> cycle;
 
     // JUST FOR TESTING WAITING GRAPH
     std::cout << "\n[DEBUG] Current waiting graph:\n";
-    for (const auto& [train, deps] : waitingGraph) {
-        std::cout << "  " << train << " is waiting for → ";
-        for (const auto& dep : deps) std::cout << dep << " ";
+    for (Train* train : {&train1, &train2}) {
+        std::cout << "  " << train->name << " is waiting for → ";
+        for (int dep : waitingGraph.waitingOn(train->id)) std::cout << dep << " ";
         std::cout << "\n";
     }
 
-    bool deadlockDetected = detectDeadlock(waitingGraph, cycle);
+    bool deadlockDetected = waitingGraph.findCycleThrough(train1.id, cycle);
 
     if (deadlockDetected) {
         std::cout << "testing.cpp: SUCCESS Deadlock detected!" << std::endl;
 
         // Perform deadlock recovery
-        std::unordered_map<std::string, std::vector<std::string>> resourceGraphTable = resourceGraph.getResourceGraph();
-        // Template trains map
-        std::unordered_map<std::string, Train*> trains = {{"Train1", &train1}, {"Train2", &train2}};
-        deadlockRecovery(trains, resourceGraphTable, cycle, 0);
+        // Template trains, indexed by id
+        std::vector<Train*> trains = {&train1, &train2};
+        Preemption preemption = deadlockRecovery(trains, resourceGraph, cycle, 0);
+
+        // Like the server: the victim's request was dropped and nobody waits on it once it holds nothing
+        if (preemption.train_id != -1)
+        {
+            waitingGraph.clearEdges(preemption.train_id);
+            for (Train* train : trains)
+            {
+                std::vector<int> waitingOn = waitingGraph.waitingOn(train->id);
+                waitingOn.erase(std::remove(waitingOn.begin(), waitingOn.end(), preemption.train_id), waitingOn.end());
+                waitingGraph.setEdges(train->id, waitingOn);
+            }
+        }
 
         // Verify that the deadlock is resolved by detecting again
-        bool deadlockResolved = !detectDeadlock(waitingGraph, cycle);
+        bool deadlockResolved = !preemption.released.empty() && !waitingGraph.findCycleThrough(train1.id, cycle);
         if (deadlockResolved) {
             std::cout << "testing.cpp: SUCCESS Deadlock resolved!" << std::endl;
         } else {
@@ -361,6 +963,317 @@ void deadlock_recovery_test() {
     }
 }
 
+// Test 4a: victim policies. Train1 holds A and C and has the higher priority, Train2 holds only B but crossing B
+// is slow, so each policy has a different idea of who to preempt
+void victim_policy_test()
+{
+    const VictimPolicy policies[] = {VICTIM_FEWEST_HELD, VICTIM_LEAST_PROGRESS, VICTIM_LOWEST_PRIORITY, VICTIM_LOWEST_COST};
+    const int expected[] = {1, 1, 0, 0};
+    bool policiesOk = true;
+    for (int i = 0; i < 4; ++i)
+    {
+        Intersection intersectionA("IntersectionA", 1, 0, 1000);
+        Intersection intersectionB("IntersectionB", 1, 1, 1500);
+        Intersection intersectionC("IntersectionC", 1, 2, 1000);
+        ResourceAllocationGraph resourceGraph;
+        resourceGraph.addIntersection(&intersectionA);
+        resourceGraph.addIntersection(&intersectionB);
+        resourceGraph.addIntersection(&intersectionC);
+        Train train1("Train1", {&intersectionA, &intersectionC, &intersectionB}, 0, {}, 0, 0);
+        Train train2("Train2", {&intersectionB, &intersectionA}, 1, {}, 0, 5);
+        std::vector<Train *> trains = {&train1, &train2};
+        resourceGraph.acquire(intersectionA.id, &train1);
+        resourceGraph.acquire(intersectionC.id, &train1);
+        resourceGraph.acquire(intersectionB.id, &train2);
+
+        Preemption preemption = deadlockRecovery(trains, resourceGraph, {train1.id, train2.id}, 0, policies[i]);
+        if (preemption.train_id != expected[i] || preemption.released.size() != (expected[i] == 0 ? 2u : 1u))
+        {
+            std::cerr << "testing.cpp: Victim policy " << victim_policy_name(policies[i]) << " picked " << preemption.train_id << std::endl;
+            policiesOk = false;
+        }
+    }
+    if (policiesOk)
+    {
+        std::cout << "testing.cpp: SUCCESS Victim policies" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Victim policies" << std::endl;
+    }
+
+    // Through the server: Train1 holds A and wants B, Train2 holds B and wants A. The victim is told with a
+    // PREEMPT and the other train is granted what it lost.
+    Intersection intersectionA("IntersectionA", 1, 0);
+    Intersection intersectionB("IntersectionB", 1, 1);
+    ::resourceGraph = ResourceAllocationGraph();
+    ::resourceGraph.addIntersection(&intersectionA);
+    ::resourceGraph.addIntersection(&intersectionB);
+    Train train1("Train1", {&intersectionA, &intersectionB}, 0);
+    Train train2("Train2", {&intersectionB, &intersectionA}, 1);
+    std::vector<Train *> trains = {&train1, &train2};
+
+    resetDispatch(trains.size());
+    registerLogNames(trains);
+    traceMessages = false;
+    std::vector<msg_request> responses;
+    responseSink = [&responses](const msg_request &msg) { responses.push_back(msg); };
+
+    uint32_t seq = 0;
+    auto request = [&](uint8_t opcode, int trainId, int intersectionId) {
+        msg_request msg;
+        msg.mtype = MSG_TYPE_DEFAULT;
+        msg.opcode = opcode;
+        msg.seq = ++seq;
+        msg.train_id = trainId;
+        msg.intersection_id = intersectionId;
+        handleRequest(msg, trains);
+    };
+    request(OP_ACQUIRE, train1.id, intersectionA.id);
+    request(OP_ACQUIRE, train2.id, intersectionB.id);
+    request(OP_ACQUIRE, train1.id, intersectionB.id);
+    request(OP_ACQUIRE, train2.id, intersectionA.id); // Closes the cycle, Train2 is preempted
+
+    bool preempted = !responses.empty() && responses.back().opcode == OP_GRANT && responses.back().train_id == train1.id &&
+                     responses[responses.size() - 2].opcode == OP_PREEMPT && responses[responses.size() - 2].train_id == train2.id &&
+                     simStats.preemptions == 1 && simStats.grantsAfterRecovery == 1;
+    if (preempted)
+    {
+        std::cout << "testing.cpp: SUCCESS Preempted train told" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Preempted train told" << std::endl;
+    }
+
+    resetDispatch(0);
+    ::resourceGraph = ResourceAllocationGraph();
+}
+
+// Test 4b: incremental deadlock detection. Only cycles through the train whose edges just changed are searched
+void incremental_deadlock_test()
+{
+    WaitForGraph waitingGraph;
+    waitingGraph.resize(3);
+    int train1 = 0, train2 = 1, train3 = 2;
+    std::vector<int> cycle;
+
+    // Train1 -> Train2 -> Train3 is a chain, not a cycle
+    waitingGraph.setEdges(train1, {train2});
+    waitingGraph.setEdges(train2, {train3});
+    bool chainOk = !waitingGraph.findCycleThrough(train2, cycle);
+
+    // Train3 waiting on Train1 closes the cycle, listed starting from Train3
+    waitingGraph.setEdges(train3, {train1});
+    bool found = waitingGraph.findCycleThrough(train3, cycle);
+    bool cycleOk = found && cycle.size() == 3 && cycle[0] == train3 && cycle[1] == train1 && cycle[2] == train2;
+
+    if (chainOk && cycleOk)
+    {
+        std::cout << "testing.cpp: SUCCESS Incremental deadlock detected!" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Incremental deadlock not detected!" << std::endl;
+    }
+
+    // Granting Train2 removes its edges and breaks the cycle
+    waitingGraph.clearEdges(train2);
+    if (!waitingGraph.findCycleThrough(train3, cycle) && !waitingGraph.findCycleThrough(train1, cycle))
+    {
+        std::cout << "testing.cpp: SUCCESS Incremental cycle cleared" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Incremental cycle cleared" << std::endl;
+    }
+}
+
+// Test 4c: deadlock avoidance. Train1 (A then B) and Train2 (B then A) deadlock if each gets its first intersection
+// and then asks for the other's, so with avoidance on Train2's grant is deferred until Train1 is through
+void deadlock_avoidance_test()
+{
+    Intersection intersectionA("IntersectionA", 1, 0);
+    Intersection intersectionB("IntersectionB", 1, 1);
+    resourceGraph = ResourceAllocationGraph();
+    resourceGraph.addIntersection(&intersectionA);
+    resourceGraph.addIntersection(&intersectionB);
+    Train train1("Train1", {&intersectionA, &intersectionB}, 0);
+    Train train2("Train2", {&intersectionB, &intersectionA}, 1);
+    std::vector<Train *> trains = {&train1, &train2};
+
+    resetDispatch(trains.size());
+    registerLogNames(trains);
+    avoidDeadlocks = true;
+    traceMessages = false;
+    std::vector<msg_request> responses;
+    responseSink = [&responses](const msg_request &msg) { responses.push_back(msg); };
+
+    uint32_t seq = 0;
+    auto request = [&](uint8_t opcode, int trainId, int intersectionId) {
+        msg_request msg;
+        msg.mtype = MSG_TYPE_DEFAULT;
+        msg.opcode = opcode;
+        msg.seq = ++seq;
+        msg.train_id = trainId;
+        msg.intersection_id = intersectionId;
+        handleRequest(msg, trains);
+    };
+    auto grants = [&responses](int trainId) {
+        return std::count_if(responses.begin(), responses.end(), [trainId](const msg_request &msg) {
+            return msg.train_id == trainId && msg.opcode == OP_GRANT;
+        });
+    };
+
+    request(OP_ACQUIRE, train1.id, intersectionA.id);
+    request(OP_ACQUIRE, train2.id, intersectionB.id); // Unsafe, Train1 still needs B
+    bool deferredOk = grants(train2.id) == 0 && simStats.deferred == 1;
+
+    request(OP_ACQUIRE, train1.id, intersectionB.id); // Train1 isn't stuck behind the deferred Train2
+    request(OP_RELEASE, train1.id, intersectionA.id);
+    request(OP_RELEASE, train1.id, intersectionB.id); // Now Train2 can have B
+    bool grantedOk = grants(train1.id) == 2 && grants(train2.id) == 1 && simStats.deadlocks == 0;
+
+    if (deferredOk && grantedOk)
+    {
+        std::cout << "testing.cpp: SUCCESS Deadlock avoided" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Deadlock avoided" << std::endl;
+    }
+
+    resetDispatch(0);
+    resourceGraph = ResourceAllocationGraph();
+}
+
+// Test 4d: sharded server. IntersectionA and IntersectionB are on different shards, so the deadlock between Train1
+// and Train2 is only found once the coordinator merges the two shards' wait-for edges
+void sharded_server_test()
+{
+    Intersection intersectionA("IntersectionA", 1, 0);
+    Intersection intersectionB("IntersectionB", 1, 1);
+    Train train1("Train1", {&intersectionA, &intersectionB}, 0);
+    Train train2("Train2", {&intersectionB, &intersectionA}, 1);
+    std::vector<Train *> trains = {&train1, &train2};
+
+    resetDispatch(trains.size());
+    registerLogNames(trains);
+    std::mutex responsesMutex; // The shards respond from their own threads
+    std::vector<msg_request> responses;
+    responseSink = [&](const msg_request &msg)
+    {
+        std::lock_guard<std::mutex> lock(responsesMutex);
+        responses.push_back(msg);
+    };
+
+    ShardedServer sharded(trains, {&intersectionA, &intersectionB}, 2);
+    uint32_t seq = 0;
+    auto request = [&](int trainId, int intersectionId)
+    {
+        msg_request msg;
+        msg.mtype = MSG_TYPE_DEFAULT;
+        msg.opcode = OP_ACQUIRE;
+        msg.seq = ++seq;
+        msg.train_id = trainId;
+        msg.intersection_id = intersectionId;
+        return msg;
+    };
+    std::vector<msg_request> first = {request(train1.id, intersectionA.id), request(train2.id, intersectionB.id)};
+    std::vector<msg_request> second = {request(train1.id, intersectionB.id), request(train2.id, intersectionA.id)};
+    sharded.handleBatch(first);
+    sharded.handleBatch(second); // Both are queued, one on each shard
+
+    // Train1 is first in the cycle and holds as much as Train2, so it is the victim and Train2 gets IntersectionA
+    bool resolved = responses.size() == 4 && responses[2].opcode == OP_PREEMPT && responses[2].train_id == train1.id &&
+                    responses[3].opcode == OP_GRANT && responses[3].train_id == train2.id && responses[3].intersection_id == intersectionA.id &&
+                    simStats.deadlocks == 1 && simStats.preemptions == 1 && simStats.grants == 3;
+    if (resolved)
+    {
+        std::cout << "testing.cpp: SUCCESS Sharded deadlock resolved" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Sharded deadlock resolved" << std::endl;
+    }
+
+    resetDispatch(0);
+}
+
+// Test 4e: event driven simulation. Same trains as the base config, replayed on simulated time without forking
+void event_driven_test()
+{
+    // Base config: every train's hops are free when it gets there, so three crossings take three seconds
+    if (runEventDriven("intersections.txt", "trains.txt") == 0 && simStats.makespan == 3 && simStats.grants == 12 && simStats.waitTime == 0)
+    {
+        std::cout << "testing.cpp: SUCCESS Event driven base config" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Event driven base config" << std::endl;
+    }
+
+    // Three trains through one mutex intersection have to take turns, waiting 1 + 2 simulated seconds in total
+    std::ofstream intersectionsFile("event_intersections.txt");
+    intersectionsFile << "IntersectionA:1\nIntersectionB:2\n";
+    intersectionsFile.close();
+    std::ofstream trainsFile("event_trains.txt");
+    trainsFile << "Train1:IntersectionA,IntersectionB\nTrain2:IntersectionA,IntersectionB\nTrain3:IntersectionA\n";
+    trainsFile.close();
+
+    if (runEventDriven("event_intersections.txt", "event_trains.txt") == 0 && simStats.makespan == 3 && simStats.waitTime == 3)
+    {
+        std::cout << "testing.cpp: SUCCESS Event driven contention" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Event driven contention" << std::endl;
+    }
+    remove("event_intersections.txt");
+    remove("event_trains.txt");
+
+    // Train2 holds IntersectionA from 0 to 2.5s. Train1 leaves at 1s and gets there at 1.5s, waits until 2.5s,
+    // crosses until 5s, travels 2s to IntersectionB and crosses it by 8s.
+    generateTimedConfig();
+    setenv("METRICS_FILE", "event_metrics.json", 1);
+    if (runEventDriven("timed_intersections.txt", "timed_trains.txt") == 0 && simStats.makespan == 8 && simStats.waitTime == 1)
+    {
+        std::cout << "testing.cpp: SUCCESS Event driven timings" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Event driven timings" << std::endl;
+    }
+    unsetenv("METRICS_FILE");
+
+    // Its metrics end at the simulated time it finished, with every grant and no queue
+    std::ifstream eventMetrics("event_metrics.json");
+    std::string metricsLine;
+    int eventGrants = 0;
+    bool endedAtMakespan = false, noQueue = false;
+    while (std::getline(eventMetrics, metricsLine))
+    {
+        size_t at = metricsLine.find("\"grants\": ");
+        if (at != std::string::npos)
+        {
+            eventGrants += atoi(metricsLine.c_str() + at + 10);
+        }
+        endedAtMakespan |= metricsLine.find("\"sim_time\": 8,") != std::string::npos;
+        noQueue |= metricsLine.find("\"request_queue_depth\": 0,") != std::string::npos;
+    }
+    if (endedAtMakespan && noQueue && eventGrants == simStats.grants && eventGrants > 0)
+    {
+        std::cout << "testing.cpp: SUCCESS Event driven metrics" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Event driven metrics" << std::endl;
+    }
+    remove("event_metrics.json");
+    remove("timed_intersections.txt");
+    remove("timed_trains.txt");
+}
+
 // Test 5: check that all logs are in correct format in output file
 void logging_test()
 {
@@ -398,6 +1311,159 @@ void logging_test()
 
     // Final completion log
     logger.logSimulationComplete();
+
+    // Async mode: the same calls are queued and written by the writer thread, long messages spill over records
+    std::string longMessage(3 * LOG_RECORD_BYTES, 'x');
+    longMessage += "END";
+    writeLog::startAsync(10);
+    bool asyncOn = writeLog::isAsync();
+    for (int i = 0; i < 2 * LOG_RING_SIZE; ++i)
+    {
+        logger.logTrainRequest("AsyncTrain" + std::to_string(i), "A", i);
+    }
+    logger.log("ASYNC", longMessage);
+    logger.logSimulationComplete(); // Writes everything out and stops the writer thread
+
+    std::ifstream logFile("simulation.log");
+    std::string line;
+    std::vector<std::string> lines;
+    while (std::getline(logFile, line))
+    {
+        lines.push_back(line);
+    }
+
+    // The last lines should be the final request, the long message in one piece, then the completion line
+    size_t n = lines.size();
+    bool asyncOk = asyncOn && !writeLog::isAsync() && n >= 3 &&
+        lines[n - 3].find("AsyncTrain" + std::to_string(2 * LOG_RING_SIZE - 1) + ": Sent ACQUIRE request for A.") != std::string::npos &&
+        lines[n - 2] == "[0:0:0] ASYNC: " + longMessage &&
+        lines[n - 1].find("SIMULATION COMPLETE") != std::string::npos;
+    if (asyncOk)
+    {
+        std::cout << "testing.cpp: SUCCESS Async logging" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Async logging" << std::endl;
+    }
+
+    // Binary mode: events by id are rendered back to the same text the string calls write
+    writeLog::setNames({"Train1", "Train2"}, {"IntersectionA", "IntersectionB"});
+    writeLog::startBinary("test_simulation.bin");
+    writeLog::logTrainRequest(0, 1, 1);
+    writeLog::logGrant(0, 1, 1, 1);
+    writeLog::logGrant(1, 0, -1, 2);
+    writeLog::logLock(1, 1, 3);
+    writeLog::log("SERVER", "Text entries are stored already formatted.", 3);
+    writeLog::logRelease(0, 1, 3661);
+    writeLog::logSimulationComplete(3661); // Closes the binary log
+
+    std::ifstream binaryLog("test_simulation.bin", std::ios::binary);
+    std::ostringstream rendered;
+    bool renderOk = !writeLog::isBinary() && writeLog::renderBinaryLog(binaryLog, rendered);
+    std::string expected =
+        "[0:0:1] Train1: Sent ACQUIRE request for IntersectionB.\n"
+        "[0:0:1] SERVER: GRANTED IntersectionB to Train1 1\n\n"
+        "[0:0:2] SERVER: GRANTED IntersectionA to Train2\n\n"
+        "[0:0:3] SERVER: IntersectionB is locked. Train2 added to wait queue.\n\n"
+        "[0:0:3] SERVER: Text entries are stored already formatted.\n"
+        "[1:1:1] Train1: Released IntersectionB.\n\n"
+        "[1:1:1] SIMULATION COMPLETE. All trains reached destinations.\n";
+    if (renderOk && rendered.str() == expected)
+    {
+        std::cout << "testing.cpp: SUCCESS Binary logging" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Binary logging" << std::endl;
+    }
+    remove("test_simulation.bin");
+}
+
+// Test 6: Trace replay, the requests recorded from a run are fed straight back into dispatch. The replay has to make
+// the same grants and end at the same sim_time as the run, and the sharded server has to respond to it exactly as
+// the single threaded dispatch does.
+void trace_replay_test(SimulationStats recorded)
+{
+    ReplayResult replayed, shardReplayed;
+    bool ok = replayTrace("trace_test.bin", "intersections.txt", "trains.txt", replayed) == 0 && replayed.completed == 4 &&
+              simStats.grants == recorded.grants && simStats.deadlocks == recorded.deadlocks && simStats.makespan == recorded.makespan;
+    setenv("SERVER_SHARDS", "3", 1);
+    ok = ok && replayTrace("trace_test.bin", "intersections.txt", "trains.txt", shardReplayed) == 0 &&
+         shardReplayed.requests == replayed.requests && shardReplayed.responses == replayed.responses && shardReplayed.digest == replayed.digest;
+    unsetenv("SERVER_SHARDS");
+
+    // A trace cut off mid record is refused
+    std::ifstream full("trace_test.bin", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(full)), std::istreambuf_iterator<char>());
+    std::ofstream cut("trace_cut.bin", std::ios::binary);
+    cut.write(bytes.data(), bytes.size() - 5);
+    cut.close();
+    TraceHeader header;
+    std::vector<std::vector<msg_request>> batches;
+    ok = ok && !loadTrace("trace_cut.bin", header, batches);
+
+    if (ok)
+    {
+        std::cout << "testing.cpp: SUCCESS Trace replay (" << replayed.requests << " requests, " << (long)replayed.requestsPerSecond() << " requests/s)" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Trace replay" << std::endl;
+    }
+    remove("trace_test.bin");
+    remove("trace_cut.bin");
+
+    // Six trains on intersections of their own, each batch puts all three shards to work at once. Every shard answers
+    // through the replay's sink at the same time, which must still see each response once.
+    std::ofstream shardIntersections("trace_intersections.txt");
+    std::ofstream shardTrains("trace_trains.txt");
+    for (int i = 0; i < 6; ++i)
+    {
+        shardIntersections << "Intersection" << i << ":1\n";
+        shardTrains << "Train" << i << ":Intersection" << i << "\n";
+    }
+    shardIntersections.close();
+    shardTrains.close();
+    TraceWriter writer;
+    writer.open("trace_shards.bin", 6, 6);
+    for (uint8_t opcode : {OP_ACQUIRE, OP_RELEASE, OP_COMPLETE})
+    {
+        std::vector<msg_request> batch;
+        for (int i = 0; i < 6; ++i)
+        {
+            msg_request msg = {};
+            msg.mtype = MSG_TYPE_DEFAULT;
+            msg.opcode = opcode;
+            msg.seq = opcode == OP_ACQUIRE ? 1 : 2;
+            msg.train_id = i;
+            msg.intersection_id = opcode == OP_COMPLETE ? -1 : i;
+            batch.push_back(msg);
+        }
+        writer.record(batch);
+    }
+    writer.close();
+
+    ReplayResult single;
+    ok = replayTrace("trace_shards.bin", "trace_intersections.txt", "trace_trains.txt", single) == 0 && single.responses == 6 && single.completed == 6;
+    setenv("SERVER_SHARDS", "3", 1);
+    for (int run = 0; run < 20 && ok; ++run)
+    {
+        ok = replayTrace("trace_shards.bin", "trace_intersections.txt", "trace_trains.txt", shardReplayed) == 0 &&
+             shardReplayed.responses == single.responses && shardReplayed.digest == single.digest && simStats.grants == 6;
+    }
+    unsetenv("SERVER_SHARDS");
+    if (ok)
+    {
+        std::cout << "testing.cpp: SUCCESS Trace replay across shards" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Trace replay across shards" << std::endl;
+    }
+    remove("trace_shards.bin");
+    remove("trace_intersections.txt");
+    remove("trace_trains.txt");
 }
 
 int main()
@@ -411,6 +1477,7 @@ int main()
 
     // Conduct parsing test
     parsing_test();
+    topology_test();
 
     std::cout << "-------------------------------------\n";
     std::cout << "Starting IPC test...\n";
@@ -418,6 +1485,7 @@ int main()
 
     // Conduct IPC test
     ipc_test();
+    shm_transport_test();
 
     std::cout << "-------------------------------------\n";
     std::cout << "Starting allocation table test...\n";
@@ -425,6 +1493,8 @@ int main()
 
     // Conduct allocation table test
     allocation_table_test();
+    wait_queue_test();
+    concurrent_admission_test();
 
     std::cout << "-------------------------------------\n";
     std::cout << "Starting deadlock recovery test...\n";
@@ -432,6 +1502,17 @@ int main()
 
     // Conduct deadlock recovery test
     deadlock_recovery_test();
+    victim_policy_test();
+    incremental_deadlock_test();
+    deadlock_avoidance_test();
+    sharded_server_test();
+
+    std::cout << "-------------------------------------\n";
+    std::cout << "Starting event driven simulation test...\n";
+    std::cout << "-------------------------------------\n";
+
+    // Conduct event driven simulation test
+    event_driven_test();
 
     std::cout << "-------------------------------------\n";
     std::cout << "Starting logging test...\n";
@@ -451,6 +1532,120 @@ int main()
         return 1;
     }
 
+    // Run totals for the base config, every train is granted each intersection on its route once
+    if (simStats.trains == 4 && simStats.grants == 12 && simStats.makespan > 0)
+    {
+        std::cout << "testing.cpp: SUCCESS Simulation stats" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Simulation stats" << std::endl;
+    }
+
+    // A run that fails after loading the network doesn't leave the graph pointing into its freed arena
+    ipc_set_key_prefix("/nonexistent/ipc");
+    int failedRun = runServer("intersections.txt", "trains.txt");
+    ipc_set_key_prefix(IPC_KEY_PREFIX);
+    if (failedRun == 1 && resourceGraph.size() == 0)
+    {
+        std::cout << "testing.cpp: SUCCESS Failed run cleaned up" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Failed run cleaned up" << std::endl;
+    }
+
+    // Same config with the trains on a thread pool instead of forked processes, recording the requests
+    setenv("TRAIN_MODE", "threads", 1);
+    setenv("TRAIN_THREADS", "2", 1);
+    setenv("TRACE_FILE", "trace_test.bin", 1);
+    if (runServer("intersections.txt", "trains.txt") == 0 && simStats.trains == 4 && simStats.grants == 12)
+    {
+        std::cout << "testing.cpp: SUCCESS Thread mode trains" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Thread mode trains" << std::endl;
+    }
+    unsetenv("TRACE_FILE");
+    trace_replay_test(simStats);
+
+    // And with the requests applied by three server shards, writing metrics as it goes
+    setenv("SERVER_SHARDS", "3", 1);
+    setenv("METRICS_FILE", "metrics_test.json", 1);
+    if (runServer("intersections.txt", "trains.txt") == 0 && simStats.trains == 4 && simStats.grants == 12)
+    {
+        std::cout << "testing.cpp: SUCCESS Sharded server" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Sharded server" << std::endl;
+    }
+
+    // The shards' grants add up to the run's in the final dump, one hold time per grant
+    std::ifstream metricsFile("metrics_test.json");
+    std::string line;
+    int metricsGrants = 0, holds = 0;
+    while (std::getline(metricsFile, line))
+    {
+        size_t at = line.find("\"grants\": ");
+        if (at != std::string::npos)
+        {
+            metricsGrants += atoi(line.c_str() + at + 10);
+        }
+        at = line.find("\"hold_us\": {\"count\": ");
+        if (at != std::string::npos)
+        {
+            holds += atoi(line.c_str() + at + 21);
+        }
+    }
+    if (metricsGrants == 12 && holds == 12)
+    {
+        std::cout << "testing.cpp: SUCCESS Server metrics" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Server metrics (" << metricsGrants << " grants, " << holds << " holds)" << std::endl;
+    }
+    remove("metrics_test.json");
+
+    // An idle server waits for requests only until the next dump is due
+    setenv("METRICS_INTERVAL_MS", "50", 1);
+    MetricsReporter reporter;
+    reporter.configureFromEnv();
+    int untilFirst = reporter.msUntilDue();
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    if (untilFirst > 0 && untilFirst <= 50 && reporter.msUntilDue() == 0 && reporter.due() && MetricsReporter().msUntilDue() == -1)
+    {
+        std::cout << "testing.cpp: SUCCESS Metrics due while idle" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Metrics due while idle" << std::endl;
+    }
+    unsetenv("METRICS_INTERVAL_MS");
+
+    // Names go into the JSON escaped, whatever the config files held
+    ServerMetrics named;
+    named.reset(true, 1, 3);
+    reporter.dump({&named}, {"Quote\"A", "Back\\B", "Tab\tC"}, 0, 0);
+    std::ifstream namedFile("metrics_test.json");
+    std::string dumped((std::istreambuf_iterator<char>(namedFile)), std::istreambuf_iterator<char>());
+    if (dumped.find("\"name\": \"Quote\\\"A\"") != std::string::npos && dumped.find("\"name\": \"Back\\\\B\"") != std::string::npos &&
+        dumped.find("\"name\": \"Tab\\u0009C\"") != std::string::npos)
+    {
+        std::cout << "testing.cpp: SUCCESS Metrics names escaped" << std::endl;
+    }
+    else
+    {
+        std::cerr << "testing.cpp: ERROR Metrics names escaped" << std::endl;
+    }
+    remove("metrics_test.json");
+    unsetenv("METRICS_FILE");
+    unsetenv("SERVER_SHARDS");
+    unsetenv("TRAIN_MODE");
+    unsetenv("TRAIN_THREADS");
+
     std::cout << "-------------------------------------\n";
     std::cout << "Starting random server test...\n";
     std::cout << "-------------------------------------\n";
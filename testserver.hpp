@@ -7,6 +7,9 @@
 #include "train.hpp"
 #include "deadlock_recovery.hpp"
 #include "resource_allocation.hpp"
+#include "deadlock_detection.hpp"
+#include "dispatch.hpp"
+#include "simulation.hpp"
 #include <iostream>
 #include <vector>
 #include <map>
@@ -15,7 +18,6 @@
 #include <condition_variable>
 #include <time.h>
 
-void handleRequest(int processID);
 
 extern std::mutex mtx;
 extern std::condition_variable cv;
@@ -24,13 +26,4 @@ extern ResourceAllocationGraph resourceGraph;
 
 int server();
 
-bool detectDeadlock(const unordered_map<string, vector<string>>& waitingGraph, vector<string>& cycle);
-
-bool isCyclicUtil(const string& node,
-    unordered_map<string, bool>& visited,
-    unordered_map<string, bool>& recursionStack,
-    const unordered_map<string, vector<string>>& graph,
-    vector<string>& cycle,
-    unordered_map<string, string>& parent);
-
 #endif
\ No newline at end of file
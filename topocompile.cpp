@@ -0,0 +1,30 @@
+/*
+Group B
+Author: Evelyn Wilson
+Email: evelyn.wilson@okstate.edu
+Date: 10/17/2026
+
+Description: Compiles the text configs into a binary topology the server can start from with TOPOLOGY_FILE.
+             Usage: ./topocompile [intersections.txt] [trains.txt] [topology.bin]. Fails without writing anything
+             if either file has an error in it.
+*/
+
+#include "topology.hpp"
+
+int main(int argc, char* argv[]) {
+    std::string intersectionsPath = argc > 1 ? argv[1] : "intersections.txt";
+    std::string trainsPath = argc > 2 ? argv[2] : "trains.txt";
+    std::string outputPath = argc > 3 ? argv[3] : TOPOLOGY_PATH;
+
+    if (!compileTopology(intersectionsPath, trainsPath, outputPath)) {
+        return 1;
+    }
+
+    Topology topology;
+    if (!topology.open(outputPath)) {
+        return 1;
+    }
+    std::cout << "topocompile.cpp: Wrote " << outputPath << " with " << topology.intersectionCount() << " intersections and "
+              << topology.trainCount() << " trains" << std::endl;
+    return 0;
+}
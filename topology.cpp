@@ -0,0 +1,254 @@
+/*
+Group B
+Author: Evelyn Wilson
+Email: evelyn.wilson@okstate.edu
+Date: 10/17/2026
+
+Description: Compiles intersections.txt and trains.txt into a versioned binary topology, with dense ids, capacities
+and every route flattened into one array, and maps it back in for the server. The config is checked when it is
+compiled, a route naming an unknown intersection fails the compile instead of being skipped at startup. Opening the
+file checks the header and then every record, each name inside the string table, each route inside the hop array
+and each hop naming an intersection that exists, in one O(n) pass. Startup stays linear as well, the server still
+builds its intersections, a Train view per train and the dispatch state from the mapping.
+*/
+
+#include "topology.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static size_t align8(size_t bytes) {
+    return (bytes + 7) & ~(size_t)7;
+}
+
+TopologyLayout::TopologyLayout(const TopologyHeader& header) {
+    intersections = align8(sizeof(TopologyHeader));
+    trains = intersections + align8(header.numIntersections * sizeof(TopologyIntersection));
+    hops = trains + align8(header.numTrains * sizeof(TopologyTrain));
+    travel = hops + align8(header.numHops * sizeof(uint32_t));
+    strings = travel + align8(header.numHops * sizeof(uint32_t));
+    total = strings + align8(header.stringBytes);
+}
+
+Topology::~Topology() {
+    if (base) {
+        munmap(const_cast<char*>(base), length);
+    }
+}
+
+bool Topology::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        std::cerr << "topology.cpp: Could not open " << path << std::endl;
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || (size_t)info.st_size < sizeof(TopologyHeader)) {
+        close(fd);
+        std::cerr << "topology.cpp: " << path << " is not a topology" << std::endl;
+        return false;
+    }
+    size_t size = info.st_size;
+    void* memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        perror("topology.cpp: mmap failed");
+        return false;
+    }
+
+    // The counts are bounded by the file size before the layout is worked out from them, so it can't overflow
+    const TopologyHeader* candidate = static_cast<const TopologyHeader*>(memory);
+    bool valid = candidate->magic == TOPOLOGY_MAGIC && candidate->version == TOPOLOGY_VERSION && candidate->fileSize == size &&
+                 candidate->numIntersections <= size && candidate->numTrains <= size && candidate->numHops <= size &&
+                 candidate->stringBytes <= size && TopologyLayout(*candidate).total == size;
+    if (!valid) {
+        munmap(memory, size);
+        std::cerr << "topology.cpp: " << path << " is not a topology from this build, compile it again with ./topocompile" << std::endl;
+        return false;
+    }
+
+    attach(memory, size);
+    if (!recordsValid()) {
+        munmap(memory, size);
+        base = nullptr;
+        std::cerr << "topology.cpp: " << path << " has records pointing outside it, compile it again with ./topocompile" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Every name has to be inside the string table, every route inside the hop array and every hop an intersection.
+// One pass over the records and the hops, nothing is allocated, so a damaged file is refused before the server
+// reads past the end of something.
+bool Topology::recordsValid() const {
+    for (uint32_t id = 0; id < header->numIntersections; ++id) {
+        const TopologyIntersection& record = intersectionRecords[id];
+        if ((uint64_t)record.nameOffset + record.nameLength > header->stringBytes) {
+            return false;
+        }
+    }
+    for (uint32_t id = 0; id < header->numTrains; ++id) {
+        const TopologyTrain& record = trainRecords[id];
+        if ((uint64_t)record.nameOffset + record.nameLength > header->stringBytes || record.firstHop > header->numHops ||
+            record.hopCount > header->numHops - record.firstHop) {
+            return false;
+        }
+    }
+    for (uint64_t hop = 0; hop < header->numHops; ++hop) {
+        if (hopIntersections[hop] >= header->numIntersections) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copies the network into an anonymous shared mapping and makes it read only. Set up before forking, every child
+// maps the same physical pages, and since nobody can write to them they are never copied.
+bool Topology::share(const std::vector<Intersection*>& intersections, const std::vector<Train*>& trains) {
+    std::vector<char> blob = serializeTopology(intersections, trains);
+    if (blob.empty()) {
+        return false;
+    }
+    void* memory = mmap(nullptr, blob.size(), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        perror("topology.cpp: mmap failed");
+        return false;
+    }
+    memcpy(memory, blob.data(), blob.size());
+    if (mprotect(memory, blob.size(), PROT_READ) == -1) {
+        perror("topology.cpp: mprotect failed");
+        munmap(memory, blob.size());
+        return false;
+    }
+    attach(memory, blob.size());
+    return true;
+}
+
+void Topology::attach(void* memory, size_t size) {
+    if (base) {
+        munmap(const_cast<char*>(base), length);
+    }
+    base = static_cast<const char*>(memory);
+    length = size;
+    header = reinterpret_cast<const TopologyHeader*>(base);
+    TopologyLayout layout(*header);
+    intersectionRecords = reinterpret_cast<const TopologyIntersection*>(base + layout.intersections);
+    trainRecords = reinterpret_cast<const TopologyTrain*>(base + layout.trains);
+    hopIntersections = reinterpret_cast<const uint32_t*>(base + layout.hops);
+    hopTravel = reinterpret_cast<const uint32_t*>(base + layout.travel);
+    strings = base + layout.strings;
+}
+
+// Lays the network out as a topology, or returns nothing if the names don't fit in 32 bit offsets
+std::vector<char> serializeTopology(const std::vector<Intersection*>& intersections, const std::vector<Train*>& trains) {
+    std::string names;
+    std::vector<TopologyIntersection> intersectionRecords;
+    for (Intersection* inter : intersections) {
+        intersectionRecords.push_back({(uint32_t)names.size(), (uint32_t)inter->name.size(), inter->capacity, inter->crossing_ms});
+        names += inter->name;
+    }
+    std::vector<TopologyTrain> trainRecords;
+    std::vector<uint32_t> hops, travel;
+    for (Train* train : trains) {
+        trainRecords.push_back({hops.size(), (uint32_t)train->route.size(), (uint32_t)names.size(), (uint32_t)train->name.size(), train->departure_ms, train->priority, 0});
+        names += train->name;
+        hops.insert(hops.end(), train->route.begin(), train->route.end());
+        travel.insert(travel.end(), train->travel_ms.begin(), train->travel_ms.end());
+    }
+    if (names.size() > UINT32_MAX) {
+        std::cerr << "topology.cpp: ERROR: names are too long for a topology" << std::endl;
+        return {};
+    }
+
+    TopologyHeader header = {};
+    header.magic = TOPOLOGY_MAGIC;
+    header.version = TOPOLOGY_VERSION;
+    header.numIntersections = intersectionRecords.size();
+    header.numTrains = trainRecords.size();
+    header.numHops = hops.size();
+    header.stringBytes = names.size();
+    TopologyLayout layout(header);
+    header.fileSize = layout.total;
+
+    std::vector<char> blob(layout.total, 0);
+    memcpy(blob.data(), &header, sizeof(header));
+    memcpy(blob.data() + layout.intersections, intersectionRecords.data(), intersectionRecords.size() * sizeof(TopologyIntersection));
+    memcpy(blob.data() + layout.trains, trainRecords.data(), trainRecords.size() * sizeof(TopologyTrain));
+    memcpy(blob.data() + layout.hops, hops.data(), hops.size() * sizeof(uint32_t));
+    memcpy(blob.data() + layout.travel, travel.data(), travel.size() * sizeof(uint32_t));
+    memcpy(blob.data() + layout.strings, names.data(), names.size());
+    return blob;
+}
+
+bool compileTopology(const std::string& intersectionsPath, const std::string& trainsPath, const std::string& outputPath) {
+    int errors = 0;
+    NetworkArena arena;
+    auto intersections = parseIntersections(intersectionsPath, arena, &errors);
+    auto trains = parseTrains(trainsPath, intersections, arena, &errors);
+    if (intersections.empty()) {
+        std::cerr << "topology.cpp: ERROR: no intersections in " << intersectionsPath << std::endl;
+        errors++;
+    }
+    if (errors > 0) {
+        std::cerr << "topology.cpp: " << errors << " errors, " << outputPath << " not written" << std::endl;
+        return false;
+    }
+
+    std::vector<char> blob = serializeTopology(intersectionsById(intersections), trainsById(trains));
+    if (blob.empty()) {
+        std::cerr << "topology.cpp: " << outputPath << " not written" << std::endl;
+        return false;
+    }
+
+    // Written next to the output and renamed over it, so a server starting meanwhile never maps half a file
+    std::string tempPath = outputPath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary);
+    out.write(blob.data(), blob.size());
+    out.close();
+    if (!out || std::rename(tempPath.c_str(), outputPath.c_str()) != 0) {
+        std::cerr << "topology.cpp: Could not write " << outputPath << std::endl;
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// The trains' routes and travel times stay in the mapping, each train is a name and two views into it. Only the
+// intersections, which the server changes as it runs, are made into objects of their own.
+bool loadTopology(const std::string& path, Topology& topology, NetworkArena& arena, std::vector<Intersection*>& intersections, std::vector<Train*>& trains) {
+    if (!topology.open(path)) {
+        return false;
+    }
+
+    intersections.resize(topology.intersectionCount());
+    for (uint32_t id = 0; id < intersections.size(); ++id) {
+        const TopologyIntersection& record = topology.intersection(id);
+        intersections[id] = arena.newIntersection(std::string(topology.name(record)), record.capacity, id, record.crossing_ms);
+    }
+
+    trains.resize(topology.trainCount());
+    for (uint32_t id = 0; id < trains.size(); ++id) {
+        const TopologyTrain& record = topology.train(id);
+        trains[id] = arena.newTrain(std::string(topology.name(record)), HopSpan(topology.route(record), record.hopCount),
+                                    HopSpan(topology.travel(record), record.hopCount), id, record.departure_ms, record.priority);
+    }
+    return true;
+}
+
+// TOPOLOGY_FILE names a topology compiled with ./topocompile to start from instead of the text configs. Only then is
+// topology opened, the text configs are parsed into the arena.
+bool loadNetwork(const std::string& intersectionsPath, const std::string& trainsPath, Topology& topology, NetworkArena& arena, std::vector<Intersection*>& intersections, std::vector<Train*>& trains) {
+    const char* topologyPath = getenv("TOPOLOGY_FILE");
+    if (topologyPath) {
+        return loadTopology(topologyPath, topology, arena, intersections, trains);
+    }
+    auto intersectionMap = parseIntersections(intersectionsPath, arena);
+    intersections = intersectionsById(intersectionMap);
+    trains = trainsById(parseTrains(trainsPath, intersectionMap, arena));
+    return true;
+}
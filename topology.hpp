@@ -0,0 +1,111 @@
+#ifndef TOPOLOGY_HPP
+#define TOPOLOGY_HPP
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "parsing.hpp"
+
+#define TOPOLOGY_MAGIC 0x4F504F544E415254ull // "TRANTOPO" read as a little endian word
+#define TOPOLOGY_VERSION 1 // Bump whenever a record below changes
+#define TOPOLOGY_PATH "topology.bin"
+
+// Compiled topology file: the header, then the intersection records by id, the train records by id, every train's
+// route as intersection ids back to back, the travel times parallel to it, and the names. Each section starts on
+// an 8 byte boundary and its offset follows from the counts in the header, so none are stored in the file.
+struct TopologyHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t numIntersections;
+    uint32_t numTrains;
+    uint32_t reserved;
+    uint64_t numHops; // Route length summed over every train
+    uint64_t stringBytes;
+    uint64_t fileSize;
+};
+
+struct TopologyIntersection {
+    uint32_t nameOffset; // Into the names
+    uint32_t nameLength;
+    uint32_t capacity;
+    uint32_t crossing_ms;
+};
+
+struct TopologyTrain {
+    uint64_t firstHop; // Into the route and travel time arrays
+    uint32_t hopCount;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t departure_ms;
+    uint32_t priority;
+    uint32_t reserved;
+};
+
+// Byte offsets of each section for the counts in a header
+struct TopologyLayout {
+    size_t intersections;
+    size_t trains;
+    size_t hops;
+    size_t travel;
+    size_t strings;
+    size_t total;
+
+    explicit TopologyLayout(const TopologyHeader& header);
+};
+
+// A topology mapped read only, either a compiled file or the server's own network shared with the train processes
+// it forks. Opening a file checks the header and the size against it, then that every name, route and hop in it
+// stays inside the file, after which the records are read straight out of the mapping with no further checks.
+class Topology {
+    private:
+    const char* base = nullptr;
+    size_t length = 0;
+    const TopologyHeader* header = nullptr;
+    const TopologyIntersection* intersectionRecords = nullptr;
+    const TopologyTrain* trainRecords = nullptr;
+    const uint32_t* hopIntersections = nullptr;
+    const uint32_t* hopTravel = nullptr;
+    const char* strings = nullptr;
+
+    void attach(void* memory, size_t size);
+    bool recordsValid() const;
+
+    public:
+    Topology() = default;
+    ~Topology();
+    Topology(const Topology&) = delete;
+    Topology& operator=(const Topology&) = delete;
+
+    bool open(const std::string& path);
+    bool share(const std::vector<Intersection*>& intersections, const std::vector<Train*>& trains);
+    bool isOpen() const { return base != nullptr; }
+
+    uint32_t intersectionCount() const { return header->numIntersections; }
+    uint32_t trainCount() const { return header->numTrains; }
+    const TopologyIntersection& intersection(uint32_t id) const { return intersectionRecords[id]; }
+    const TopologyTrain& train(uint32_t id) const { return trainRecords[id]; }
+    std::string_view name(const TopologyIntersection& intersection) const { return std::string_view(strings + intersection.nameOffset, intersection.nameLength); }
+    std::string_view name(const TopologyTrain& train) const { return std::string_view(strings + train.nameOffset, train.nameLength); }
+    const uint32_t* route(const TopologyTrain& train) const { return hopIntersections + train.firstHop; }
+    const uint32_t* travel(const TopologyTrain& train) const { return hopTravel + train.firstHop; }
+};
+
+// Lays the network out as a topology, by id, or returns nothing if it can't be
+std::vector<char> serializeTopology(const std::vector<Intersection*>& intersections, const std::vector<Train*>& trains);
+
+// Parses the text configs and writes them to outputPath as a topology. Any parse error fails the compile and
+// nothing is written.
+bool compileTopology(const std::string& intersectionsPath, const std::string& trainsPath, const std::string& outputPath);
+
+// Maps a compiled topology into topology and runs the network from it: the Intersection and Train objects, by id,
+// go in arena and the trains' routes are views of the mapping, so topology has to outlive them
+bool loadTopology(const std::string& path, Topology& topology, NetworkArena& arena, std::vector<Intersection*>& intersections, std::vector<Train*>& trains);
+
+// Loads the network by id from the file named by TOPOLOGY_FILE if it is set, leaving topology open on it, otherwise
+// parses the text configs
+bool loadNetwork(const std::string& intersectionsPath, const std::string& trainsPath, Topology& topology, NetworkArena& arena, std::vector<Intersection*>& intersections, std::vector<Train*>& trains);
+
+#endif
@@ -0,0 +1,183 @@
+/*
+Group B
+Author: Gavin Zlatar
+Email: gavin.zlatar@okstate.edu
+Date: 10/17/2026
+
+Description: Records the requests the server receives to the file named by TRACE_FILE and replays a recorded trace
+straight into dispatch with no trains behind it. A replay makes the same calls in the same batches as the run it
+was recorded from, so it measures how fast the server alone can go and shows whether two builds hand out the
+same grants and find the same deadlocks on identical input.
+*/
+
+#include "trace.hpp"
+#include "simulation.hpp"
+
+#include <cstdlib>
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::configureFromEnv(size_t numTrains, size_t numIntersections) {
+    const char* path = getenv("TRACE_FILE");
+    return path && open(path, numTrains, numIntersections);
+}
+
+bool TraceWriter::open(const std::string& path, size_t numTrains, size_t numIntersections) {
+    close();
+    out.open(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "trace.cpp: Could not open " << path << std::endl;
+        return false;
+    }
+    TraceHeader header = {};
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.numTrains = numTrains;
+    header.numIntersections = numIntersections;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    buffer.reserve(TRACE_BUFFER_RECORDS);
+    arrivals = 0;
+    batches = 0;
+    return true;
+}
+
+void TraceWriter::record(const std::vector<msg_request>& batch) {
+    if (!isOpen()) {
+        return;
+    }
+    for (const msg_request& msg : batch) {
+        buffer.push_back({arrivals++, batches, 0, msg});
+        if (buffer.size() == TRACE_BUFFER_RECORDS) {
+            flush();
+        }
+    }
+    batches++;
+}
+
+void TraceWriter::flush() {
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(TraceRecord));
+    buffer.clear();
+}
+
+void TraceWriter::close() {
+    if (!isOpen()) {
+        return;
+    }
+    flush();
+    out.close();
+}
+
+bool loadTrace(const std::string& path, TraceHeader& header, std::vector<std::vector<msg_request>>& batches) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "trace.cpp: Could not open " << path << std::endl;
+        return false;
+    }
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != TRACE_MAGIC || header.version != TRACE_VERSION) {
+        std::cerr << "trace.cpp: " << path << " is not a trace from this build" << std::endl;
+        return false;
+    }
+
+    batches.clear();
+    TraceRecord record;
+    uint64_t arrivals = 0;
+    while (in.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+        // Batches only ever move on by one, anything else means the records were damaged
+        bool sameBatch = !batches.empty() && record.batch == batches.size() - 1;
+        if (record.arrival != arrivals++ || (!sameBatch && record.batch != batches.size())) {
+            std::cerr << "trace.cpp: " << path << " is out of order at request " << arrivals - 1 << std::endl;
+            return false;
+        }
+        if (!sameBatch) {
+            batches.emplace_back();
+        }
+        batches.back().push_back(record.msg);
+    }
+    if (in.gcount() != 0) {
+        std::cerr << "trace.cpp: " << path << " is cut off after request " << arrivals << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Mixes one response into a hash, added up over all responses so trains served by different shards can land in
+// any order, while each train's own responses count in the order it got them
+static uint64_t responseHash(const msg_request& msg, uint64_t index) {
+    uint64_t hash = ((uint64_t)(uint32_t)msg.train_id << 32 | (uint32_t)msg.intersection_id) ^ (index << 40) ^ ((uint64_t)msg.opcode << 56) ^ msg.seq;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+}
+
+int replayTrace(const std::string& tracePath, const std::string& intersectionsPath, const std::string& trainsPath, ReplayResult& result) {
+    result = ReplayResult();
+    TraceHeader header;
+    std::vector<std::vector<msg_request>> batches;
+    if (!loadTrace(tracePath, header, batches)) {
+        return 1;
+    }
+
+    resourceGraph = ResourceAllocationGraph();
+    Topology topology;
+    NetworkArena arena;
+    vector<Intersection*> intersections;
+    vector<Train*> trainsList;
+    if (!loadNetwork(intersectionsPath, trainsPath, topology, arena, intersections, trainsList)) {
+        std::cerr << "trace.cpp: Failed to load the network.\n";
+        return 1;
+    }
+    if (trainsList.size() != header.numTrains || intersections.size() != header.numIntersections) {
+        std::cerr << "trace.cpp: " << tracePath << " was recorded with " << header.numTrains << " trains and " << header.numIntersections
+                  << " intersections, the network has " << trainsList.size() << " and " << intersections.size() << std::endl;
+        return 1;
+    }
+    for (Intersection* inter : intersections) {
+        resourceGraph.addIntersection(inter);
+    }
+
+    resetDispatch(trainsList.size());
+    registerLogNames(trainsList);
+
+    // Responses have nowhere to go, they are only counted and hashed
+    std::vector<uint64_t> responsesTo(trainsList.size(), 0);
+    responseSink = [&](const msg_request& msg) {
+        result.responses++;
+        result.digest += responseHash(msg, responsesTo[msg.train_id]++);
+    };
+    traceMessages = false;
+
+    int numShards = serverShardsFromEnv();
+    if (numShards > 1 && avoidDeadlocks) {
+        numShards = 1; // As in runServer
+    }
+    std::unique_ptr<ShardedServer> sharded;
+    if (numShards > 1) {
+        sharded.reset(new ShardedServer(trainsList, intersections, numShards));
+    }
+    writeLog::configureFromEnv();
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::vector<msg_request>& batch : batches) {
+        result.requests += batch.size();
+        result.completed += sharded ? sharded->handleBatch(batch) : handleBatch(batch, trainsList);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.batches = batches.size();
+    sharded.reset();
+
+    simStats.makespan = sim_time;
+    simStats.wallSeconds = result.seconds;
+    if (result.completed == (int)trainsList.size()) {
+        writeLog::logSimulationComplete(sim_time);
+    } else {
+        writeLog::stopAsync();
+        writeLog::stopBinary();
+    }
+
+    responseSink = nullptr;
+    traceMessages = true;
+    resourceGraph = ResourceAllocationGraph(); // It points into the arena
+    return 0;
+}
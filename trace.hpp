@@ -0,0 +1,76 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <stdint.h>
+#include "ipc.hpp"
+
+#define TRACE_MAGIC 0x45434152544E5254ull // "TRNTRACE" read as a little endian word
+#define TRACE_VERSION 1 // Bump whenever a record below or msg_request changes
+#define TRACE_BUFFER_RECORDS 4096 // Records held before they are written out
+
+// Request trace written with TRACE_FILE: the header, then one record per request the server received, in the order
+// it received them. Requests that arrived in the same receive_batch share a batch number, so a replay hands
+// dispatch the same batches the server saw.
+struct TraceHeader {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t numTrains; // The network it was recorded against, a replay refuses any other
+    uint32_t numIntersections;
+    uint32_t reserved;
+};
+
+struct TraceRecord {
+    uint64_t arrival; // Position in the order the server received requests, from 0
+    uint32_t batch;
+    uint32_t reserved;
+    msg_request msg;
+};
+
+// Appends every batch the server receives to the trace. Records are buffered and written in chunks, so recording
+// costs the server a copy per request.
+class TraceWriter {
+    private:
+    std::ofstream out;
+    std::vector<TraceRecord> buffer;
+    uint64_t arrivals = 0;
+    uint32_t batches = 0;
+
+    void flush();
+
+    public:
+    ~TraceWriter();
+
+    // TRACE_FILE names the trace, nothing is recorded without it
+    bool configureFromEnv(size_t numTrains, size_t numIntersections);
+    bool open(const std::string& path, size_t numTrains, size_t numIntersections);
+    bool isOpen() const { return out.is_open(); }
+    void record(const std::vector<msg_request>& batch);
+    void close();
+};
+
+// Reads a whole trace into its batches. Fails on a trace from another build or one that is cut off.
+bool loadTrace(const std::string& path, TraceHeader& header, std::vector<std::vector<msg_request>>& batches);
+
+// What a replay did. The digest hashes every response each train got, in the order it got them, so two builds
+// that grant, deny and preempt the same way on the same trace print the same digest.
+struct ReplayResult {
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+    uint64_t responses = 0;
+    uint64_t digest = 0;
+    int completed = 0; // Trains that reported their route complete
+    double seconds = 0; // Dispatch time only, not loading the network or the trace
+
+    double requestsPerSecond() const { return seconds > 0 ? requests / seconds : 0; }
+};
+
+// Feeds a recorded trace straight into the server's dispatch as fast as it will take it, with no trains, IPC or
+// sleeps. The network is loaded like runServer loads it and must be the one the trace was recorded against.
+// SERVER_SHARDS, DEADLOCK_MODE, VICTIM_POLICY and LOG_MODE apply as they do to the server. Totals are left in
+// simStats. Returns 0 on success.
+int replayTrace(const std::string& tracePath, const std::string& intersectionsPath, const std::string& trainsPath, ReplayResult& result);
+
+#endif
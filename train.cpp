@@ -17,23 +17,22 @@ Description:
 
 using namespace std;
 
-void train_forking(std::unordered_map<string, Intersection*>& intersections, std::unordered_map<string, Train*>& trains) {
+// The trains only read the shared topology, so every train process keeps sharing its pages with the server
+void train_forking(const Topology& topology) {
 
     // Create a vector to store pids for each train's fork
     std::vector<pid_t> train_pids;
 
-    std::vector<Train*> train_ptrs;
-
-    // For every train in trains, create a fork
-    for(const auto& train_pair : trains){
-        Train* train = train_pair.second;  // Access the Train* from the map
-        train_ptrs.push_back(train);
+    // For every train in the topology, create a fork
+    for (uint32_t trainId = 0; trainId < topology.trainCount(); ++trainId) {
+        // Each train gets its own response mtype from its id, so replies go straight to it
+        long reply_type = TRAIN_REPLY_TYPE(trainId);
 
         pid_t pid = fork();
     
         if (pid == 0) {
-            std::cout << "train.cpp: " << train->name << " starting its journey!" << std::endl;
-            train_behavior(train);
+            std::cout << "train.cpp: " << topology.name(topology.train(trainId)) << " starting its journey!" << std::endl;
+            train_behavior(topology, trainId, reply_type);
             exit(0);
         } else if (pid > 0){
             train_pids.push_back(pid); // To match trains' index
@@ -47,11 +46,6 @@ void train_forking(std::unordered_map<string, Intersection*>& intersections, std
         wait(NULL);
     }
     
-    // Clean up memory in parent process
-    for (auto& train_pair : trains) {
-        delete train_pair.second;
-    }
-    
     std::cout << "train.cpp: All trains have completed their routes!" << std::endl;
     
     }
@@ -59,11 +53,29 @@ void train_forking(std::unordered_map<string, Intersection*>& intersections, std
 // Mutex for train queues
 pthread_mutex_t responseMutex = PTHREAD_MUTEX_INITIALIZER;
 
-void train_behavior(Train *train)
+static void sleep_ms(unsigned int ms)
+{
+    struct timespec req = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000L};
+    nanosleep(&req, nullptr);
+}
+
+// Runs one train through its route in the topology. hop is the only thing it changes, the topology stays shared.
+void train_behavior(const Topology& topology, uint32_t trainId, long reply_type)
 {
-    while (!train->route.empty())
+    const TopologyTrain& train = topology.train(trainId);
+    std::string_view trainName = topology.name(train);
+    const uint32_t* route = topology.route(train);
+    const uint32_t* travel_ms = topology.travel(train);
+    uint32_t seq = 0; // Numbers this train's requests, the server echoes it back in its response
+    uint32_t acquireSeq = 0; // Sequence number of the outstanding ACQUIRE
+
+    sleep_ms(train.departure_ms); // Wait for the departure time
+
+    for (uint32_t hop = 0; hop < train.hopCount; ++hop)
     {
-        Intersection *intersection = train->route.front();
+        uint32_t intersectionId = route[hop];
+        const TopologyIntersection& intersection = topology.intersection(intersectionId);
+        sleep_ms(travel_ms[hop]); // Travel to the next intersection
         bool acquired = false;
         bool waitingForResponse = false;
 
@@ -74,72 +86,88 @@ void train_behavior(Train *train)
             {
                 // Send ACQUIRE request only if not waiting for a response
                 msg_request msg;
-                msg.mtype = 1;
-                strcpy(msg.command, "ACQUIRE");
-                strcpy(msg.train_name, train->name.c_str());
-                strcpy(msg.intersection, intersection->name.c_str());
+                msg.mtype = MSG_TYPE_DEFAULT;
+                msg.opcode = OP_ACQUIRE;
+                msg.seq = acquireSeq = ++seq;
+                msg.train_id = trainId;
+                msg.intersection_id = intersectionId;
 
-                std::cout << "train.cpp: Sending message: " << msg.train_name << " " << msg.command << " " << msg.intersection << " " << std::endl;
+                std::cout << "train.cpp: Sending message: " << trainName << " " << opcode_name(msg.opcode) << " " << topology.name(intersection) << " " << std::endl;
                 send_msg(requestQueueId, msg);
 
                 waitingForResponse = true;
             }
             pthread_mutex_unlock(&responseMutex); // Unlock the mutex
 
-            // Wait for the server's response
+            // Wait for the server's response, only replies addressed to this train are delivered
             msg_request msg;
-            if (receive_msg(responseQueueId, msg, 1) == -1){
+            if (receive_msg(responseQueueId, msg, reply_type) == -1){
                 std::cerr << "train.cpp: Failed to receive message" << std::endl;
                 continue; // Retry if receiving the message fails
             }
-            std::cout << "train.cpp: Received message: " << msg.train_name << " " << msg.command << " " << msg.intersection << " " << std::endl;
+            std::cout << "train.cpp: Received message: " << trainName << " " << opcode_name(msg.opcode) << " " << msg.intersection_id << " " << std::endl;
 
             pthread_mutex_lock(&responseMutex); // Lock the mutex when gets a message
-            
-            if (strcmp(msg.command, "GRANT") == 0)
+
+            if (msg.seq != acquireSeq)
+            {
+                // Stale reply to an earlier request (e.g. a DENY for a release), keep waiting for this one
+                pthread_mutex_unlock(&responseMutex);
+                continue;
+            }
+
+            switch (msg.opcode)
+            {
+            case OP_GRANT:
             {
                 acquired = true;
 
-                struct timespec req = {1, 0};
-                nanosleep(&req, nullptr); // Simulate travel time
+                sleep_ms(intersection.crossing_ms); // Simulate crossing time
 
-                // Release the intersection after traveling
-                strcpy(msg.command, "RELEASE");
-                strcpy(msg.train_name, train->name.c_str());
-                strcpy(msg.intersection, intersection->name.c_str());
+                // Release the intersection after traveling, the loop then moves on to the next hop
+                msg.mtype = MSG_TYPE_DEFAULT;
+                msg.opcode = OP_RELEASE;
+                msg.seq = ++seq;
+                msg.train_id = trainId;
+                msg.intersection_id = intersectionId;
                 send_msg(requestQueueId, msg);
-                std::cout << "train.cpp: Released intersection: " << intersection->name << std::endl << std::flush;
-
-                train->route.erase(train->route.begin());
-
-                // Update the current intersection
-                if (!train->route.empty())
-                {
-                    intersection = train->route.front();
-                }
+                std::cout << "train.cpp: Released intersection: " << topology.name(intersection) << std::endl << std::flush;
 
                 waitingForResponse = false;
+                break;
             }
-            else if (strcmp(msg.command, "WAIT") == 0)
+            case OP_WAIT:
+                // Server has queued this train, the GRANT is pushed once the intersection frees up so don't resend
+                break;
+            case OP_DENY:
             {
-                // Wait before retrying
-                struct timespec req = {0, 500000000};
-                nanosleep(&req, nullptr); // Wait
+                sleep_ms(TRAIN_RETRY_MS); // Wait
                 waitingForResponse = false;
+                break;
             }
-            else if (strcmp(msg.command, "DENY") == 0)
+            case OP_PREEMPT:
             {
-                struct timespec req = {0, 500000000};
-                nanosleep(&req, nullptr); // Wait
+                // Deadlock recovery dropped this request. The train releases each intersection before asking for
+                // the next, so it lost nothing it has to cross again and just asks again.
+                std::cout << "train.cpp: " << trainName << " was preempted, requesting " << topology.name(intersection) << " again" << std::endl;
+                sleep_ms(TRAIN_RETRY_MS);
                 waitingForResponse = false;
+                break;
+            }
+            default:
+                std::cerr << "train.cpp: Unknown response opcode " << (int)msg.opcode << std::endl;
+                break;
             }
             pthread_mutex_unlock(&responseMutex); // Unlock the mutex for next route
         }
     }
 
-    std::cout << "train.cpp: Train " << train->name << " has completed its route!" << std::endl;
+    std::cout << "train.cpp: Train " << trainName << " has completed its route!" << std::endl;
     msg_request msg;
-    strcpy(msg.command, "COMPLETE");
-    strcpy(msg.train_name, train->name.c_str());
+    msg.mtype = MSG_TYPE_DEFAULT;
+    msg.opcode = OP_COMPLETE;
+    msg.seq = ++seq;
+    msg.train_id = trainId;
+    msg.intersection_id = -1;
     send_msg(requestQueueId, msg);
 }
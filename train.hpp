@@ -5,9 +5,12 @@
 #include <sys/wait.h>
 #include <pthread.h>
 #include "parsing.hpp"
+#include "topology.hpp"
 #include <unordered_map>
 
-void train_forking(std::unordered_map<std::string, Intersection*>& intersections, std::unordered_map<std::string, Train*>& trains);
+#define TRAIN_RETRY_MS 500 // Real time a denied train waits before asking again
 
-void train_behavior(Train* train);
+void train_forking(const Topology& topology);
+
+void train_behavior(const Topology& topology, uint32_t trainId, long reply_type);
 #endif
\ No newline at end of file
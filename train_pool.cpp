@@ -0,0 +1,198 @@
+/*
+Group B
+Author: Myron Peoples
+Email: myron.peoples@okstate.edu
+Date: 10/17/2026
+Description: Runs trains as tasks on a fixed pool of worker threads inside the server process. Each train follows
+the same steps as train_behavior in train.cpp (depart, travel to the next intersection, ACQUIRE, cross it once
+granted, RELEASE, COMPLETE at the end, back off TRAIN_RETRY_MS on a DENY), but as a state machine driven by responses
+and timers, so thousands of trains need no processes and only a handful of threads.
+*/
+
+#include "train_pool.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+// TRAIN_MODE=threads runs the trains on the pool instead of forking them
+bool threadModeFromEnv() {
+    const char* mode = getenv("TRAIN_MODE");
+    return mode && strcmp(mode, "threads") == 0;
+}
+
+// TRAIN_THREADS sets the number of workers, by default one per core
+int trainThreadsFromEnv() {
+    const char* threads = getenv("TRAIN_THREADS");
+    int count = threads ? atoi(threads) : (int)std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+TrainPool::TrainPool(std::vector<Train*>& trains, const std::vector<Intersection*>& intersections, int numWorkers)
+    : trains(trains), intersections(intersections), numWorkers(numWorkers) {
+    for (size_t i = 0; i < trains.size(); ++i) {
+        progress.emplace_back(new TrainProgress());
+    }
+}
+
+TrainPool::~TrainPool() {
+    stop();
+}
+
+// Every train starts by requesting its first intersection
+void TrainPool::start() {
+    for (Train* train : trains) {
+        push({train->id, TASK_START, msg_request()});
+    }
+    for (int i = 0; i < numWorkers; ++i) {
+        workers.emplace_back(&TrainPool::workerLoop, this);
+    }
+    std::cout << "train_pool.cpp: " << trains.size() << " trains starting their journey on " << numWorkers << " threads!" << std::endl;
+}
+
+// Called on the server thread for every response, the train handles it on a worker
+void TrainPool::deliver(const msg_request& msg) {
+    push({msg.train_id, TASK_RESPONSE, msg});
+}
+
+void TrainPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void TrainPool::push(const TrainTask& task) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        ready.push_back(task);
+    }
+    queueReady.notify_one();
+}
+
+// Stands in for nanosleep: the train is parked and a TASK_WAKE is queued once the time is up
+void TrainPool::wakeAfter(int trainId, int milliseconds) {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        timers.push({std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds), trainId});
+    }
+    queueReady.notify_one(); // An idle worker may be sleeping until a later timer
+}
+
+// Runs ready tasks, turning timers that are due into tasks. Sleeps until the next timer when there is nothing to do.
+void TrainPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (!stopping) {
+        auto now = std::chrono::steady_clock::now();
+        while (!timers.empty() && timers.top().when <= now) {
+            ready.push_back({timers.top().train_id, TASK_WAKE, msg_request()});
+            timers.pop();
+        }
+
+        if (!ready.empty()) {
+            TrainTask task = ready.front();
+            ready.pop_front();
+            lock.unlock();
+            run(task);
+            lock.lock();
+            continue;
+        }
+
+        if (timers.empty()) {
+            queueReady.wait(lock);
+        } else {
+            queueReady.wait_until(lock, timers.top().when);
+        }
+    }
+}
+
+void TrainPool::sendRequest(int trainId, TrainProgress& train, uint8_t opcode, int intersectionId) {
+    msg_request msg;
+    msg.mtype = MSG_TYPE_DEFAULT;
+    msg.opcode = opcode;
+    msg.seq = ++train.seq;
+    msg.train_id = trainId;
+    msg.intersection_id = intersectionId;
+    if (opcode == OP_ACQUIRE) {
+        train.acquireSeq = msg.seq; // Set before sending, the GRANT can come back before send_msg returns
+    }
+    send_msg(requestQueueId, msg);
+}
+
+// Waits out the travel time to the next hop (plus extraMs, the departure time for the first one) before requesting it
+void TrainPool::travelToNextHop(int trainId, TrainProgress& train, unsigned int extraMs) {
+    const Train* config = trains[trainId];
+    unsigned int delay = extraMs + (train.hop < config->route.size() ? config->travel_ms[train.hop] : 0);
+    if (delay == 0) {
+        requestNextHop(trainId, train);
+        return;
+    }
+    train.phase = PHASE_TRAVELING;
+    wakeAfter(trainId, delay);
+}
+
+// ACQUIRE the next intersection on the route, or COMPLETE if there isn't one
+void TrainPool::requestNextHop(int trainId, TrainProgress& train) {
+    const HopSpan& route = trains[trainId]->route;
+    if (train.hop >= route.size()) {
+        train.phase = PHASE_DONE;
+        sendRequest(trainId, train, OP_COMPLETE, -1);
+        return;
+    }
+    train.phase = PHASE_WAITING_GRANT;
+    sendRequest(trainId, train, OP_ACQUIRE, route[train.hop]);
+}
+
+void TrainPool::run(const TrainTask& task) {
+    TrainProgress& train = *progress[task.train_id];
+    std::lock_guard<std::mutex> lock(train.lock);
+
+    switch (task.kind) {
+    case TASK_START:
+        travelToNextHop(task.train_id, train, trains[task.train_id]->departure_ms);
+        break;
+
+    case TASK_RESPONSE:
+        // Stale reply to an earlier request (e.g. a DENY for a release), or not waiting for one
+        if (task.msg.seq != train.acquireSeq || train.phase != PHASE_WAITING_GRANT) {
+            break;
+        }
+        switch (task.msg.opcode) {
+        case OP_GRANT:
+            train.phase = PHASE_CROSSING;
+            wakeAfter(task.train_id, intersections[trains[task.train_id]->route[train.hop]]->crossing_ms); // Simulate crossing time
+            break;
+        case OP_WAIT:
+            // Server has queued this train, the GRANT is pushed once the intersection frees up
+            break;
+        case OP_DENY:
+            train.phase = PHASE_BACKING_OFF;
+            wakeAfter(task.train_id, TRAIN_RETRY_MS);
+            break;
+        case OP_PREEMPT:
+            // Request dropped by deadlock recovery. Nothing before this hop is still held, so it only asks again.
+            train.phase = PHASE_BACKING_OFF;
+            wakeAfter(task.train_id, TRAIN_RETRY_MS);
+            break;
+        default:
+            std::cerr << "train_pool.cpp: Unknown response opcode " << (int)task.msg.opcode << std::endl;
+            break;
+        }
+        break;
+
+    case TASK_WAKE:
+        if (train.phase == PHASE_CROSSING) {
+            // Release the intersection after crossing and move on
+            sendRequest(task.train_id, train, OP_RELEASE, trains[task.train_id]->route[train.hop]);
+            train.hop++;
+            travelToNextHop(task.train_id, train, 0);
+        } else if (train.phase == PHASE_TRAVELING || train.phase == PHASE_BACKING_OFF) {
+            requestNextHop(task.train_id, train);
+        }
+        break;
+    }
+}
@@ -0,0 +1,79 @@
+#ifndef TRAIN_POOL_HPP
+#define TRAIN_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <queue>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "parsing.hpp"
+#include "ipc.hpp"
+#include "train.hpp"
+
+// Thread mode (TRAIN_MODE=threads): every train is a small state machine run by a fixed pool of worker threads in the
+// server process, instead of a forked process. A train never blocks a worker: waiting for a GRANT or crossing an
+// intersection just leaves it parked until its response or timer comes in. The parsed trains and intersections are
+// only read, the train's position is kept here.
+class TrainPool {
+    private:
+    enum TaskKind { TASK_START, TASK_RESPONSE, TASK_WAKE };
+    enum Phase { PHASE_TRAVELING, PHASE_WAITING_GRANT, PHASE_CROSSING, PHASE_BACKING_OFF, PHASE_DONE };
+
+    struct TrainTask {
+        int train_id;
+        TaskKind kind;
+        msg_request msg; // For TASK_RESPONSE
+    };
+
+    struct Timer {
+        std::chrono::steady_clock::time_point when;
+        int train_id;
+        bool operator>(const Timer& other) const { return when > other.when; }
+    };
+
+    // One train's progress along its route. Only one task runs for a train at a time, but a stale response can
+    // arrive while its timer fires, so each train has its own lock.
+    struct TrainProgress {
+        std::mutex lock;
+        size_t hop = 0; // Index into the route of the intersection it is at or waiting for
+        uint32_t seq = 0;
+        uint32_t acquireSeq = 0;
+        Phase phase = PHASE_WAITING_GRANT;
+    };
+
+    std::vector<Train*>& trains;
+    const std::vector<Intersection*>& intersections; // By id, routes hold intersection ids
+    std::vector<std::unique_ptr<TrainProgress>> progress;
+    std::vector<std::thread> workers;
+    int numWorkers;
+
+    std::mutex queueMutex; // Guards ready, timers and stopping
+    std::condition_variable queueReady;
+    std::deque<TrainTask> ready;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers;
+    bool stopping = false;
+
+    void workerLoop();
+    void run(const TrainTask& task);
+    void push(const TrainTask& task);
+    void wakeAfter(int trainId, int milliseconds);
+    void sendRequest(int trainId, TrainProgress& train, uint8_t opcode, int intersectionId);
+    void requestNextHop(int trainId, TrainProgress& train);
+    void travelToNextHop(int trainId, TrainProgress& train, unsigned int extraMs);
+
+    public:
+    TrainPool(std::vector<Train*>& trains, const std::vector<Intersection*>& intersections, int numWorkers);
+    ~TrainPool();
+
+    void start();
+    void deliver(const msg_request& msg);
+    void stop();
+};
+
+bool threadModeFromEnv();
+int trainThreadsFromEnv();
+
+#endif